@@ -0,0 +1,121 @@
+/**
+ * @file benchmark.hpp
+ * @brief 外部ライブラリに依存しないマイクロベンチマークの枠組み
+ */
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cstddef>
+
+namespace benchmark {
+    /**
+     * @brief 計測結果
+     */
+    struct result {
+        //! ベンチマークの名前
+        std::string name;
+
+        //! 一回の標本あたりの操作回数
+        std::size_t iterations;
+
+        //! 標本ごとの一操作あたりの時間（ナノ秒）
+        std::vector<double> ns_per_op;
+    };
+
+    /**
+     * @brief 一回の標本の計測値
+     */
+    struct sample {
+        //! 経過時間（ナノ秒）
+        double elapsed_ns;
+
+        //! その間に行った操作の回数
+        std::size_t operations;
+    };
+
+    //! 一つのベンチマークで取る標本の数
+    static inline constexpr std::size_t sample_count = 7;
+
+    //! 一回の標本にかける時間の下限
+    static inline constexpr std::chrono::nanoseconds min_sample_time = std::chrono::milliseconds(50);
+
+    /**
+     * @brief 値を計算したことにし、最適化で計算が消されるのを防ぐ
+     * @param value 計算した値
+     */
+    template <class T>
+    inline void do_not_optimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * @brief 計測結果を JSON Lines の一行として出力する
+     * @param r 計測結果
+     * @param os 出力先
+     * @note 中央値を代表値とし、最小値と最大値も併せて出力する。
+     */
+    inline void report(result r, std::ostream &os = std::cout)
+    {
+        std::ranges::sort(r.ns_per_op);
+        const auto median = r.ns_per_op[r.ns_per_op.size() / 2];
+        os << "{\"benchmark\":\"" << r.name << "\""
+           << ",\"iterations\":" << r.iterations
+           << ",\"samples\":" << r.ns_per_op.size()
+           << ",\"ns_per_op\":" << median
+           << ",\"ns_per_op_min\":" << r.ns_per_op.front()
+           << ",\"ns_per_op_max\":" << r.ns_per_op.back()
+           << ",\"ops_per_sec\":" << 1e9 / median
+           << "}\n" << std::flush;
+    }
+
+    /**
+     * @brief 準備を除いた時間を標本ごとに計る
+     * @param name ベンチマークの名前
+     * @param measure_once 一回の標本を計測して sample を返す関数
+     * @note 一回目は暖機として捨てる。
+     */
+    template <class F>
+    void run_samples(const std::string_view name, F measure_once)
+    {
+        measure_once();
+        result r{std::string(name), 0, {}};
+        for (std::size_t i = 0; i < sample_count; ++i) {
+            const auto s = measure_once();
+            r.iterations = std::max(r.iterations, s.operations);
+            r.ns_per_op.push_back(s.elapsed_ns / static_cast<double>(std::max<std::size_t>(s.operations, 1)));
+        }
+        report(std::move(r));
+    }
+
+    /**
+     * @brief 短い処理を繰り返して計る
+     * @param name ベンチマークの名前
+     * @param body 繰り返し回数を受け取り、その回数だけ処理を行う関数
+     * @note 一回の標本が min_sample_time 以上になるまで繰り返し回数を倍にしてから計測する。
+     */
+    template <class F>
+    void run(const std::string_view name, F body)
+    {
+        using clock = std::chrono::steady_clock;
+        const auto time = [&body](const std::size_t iterations) {
+            const auto start = clock::now();
+            body(iterations);
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        };
+        std::size_t iterations = 1;
+        while (time(iterations) < min_sample_time) {
+            iterations *= 2;
+        }
+        run_samples(name, [&] {
+            return sample{static_cast<double>(time(iterations).count()), iterations};
+        });
+    }
+}
+#endif
@@ -0,0 +1,256 @@
+/**
+ * @file main.cpp
+ * @brief マイクロベンチマークの main 関数
+ * @detail 各ベンチマークの結果を JSON Lines で標準出力へ書き出す。
+ * @detail コマンドライン引数を与えた場合、名前にそのいずれかを含むベンチマークだけを実行する。
+ */
+
+#include "benchmark.hpp"
+#include "malbolge.hpp"
+#include "malbolge_machine_state.hpp"
+#include "malbolge_search.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <span>
+#include <memory>
+#include <iterator>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+    //! 入力の配列の大きさ。2 のべき乗にして添字をマスクで求める。
+    constexpr std::size_t input_count = 1 << 12;
+
+    //! 入力の生成に用いる乱数のシード
+    constexpr std::uint32_t input_seed = 20240601;
+
+    //! 探索のベンチマークに用いるシード
+    constexpr std::array<std::uint32_t, 3> search_seeds = {1, 2, 3};
+
+    //! 探索のベンチマークに用いるビーム幅
+    constexpr std::size_t search_beam_width = 1000;
+
+    //! 探索のベンチマークで計測する前に進める世代数
+    constexpr std::size_t search_warmup_generations = 16;
+
+    //! 探索の目標文字列
+    constexpr std::string_view target = "Hello World";
+
+    /**
+     * @brief 一様な乱数のワード列を作る
+     * @param engine 乱数生成器
+     * @param min 最小値
+     * @param max 最大値
+     * @return input_count 個のワード
+     */
+    std::vector<malbolge::word> random_words(std::mt19937 &engine, const malbolge::word min, const malbolge::word max)
+    {
+        std::uniform_int_distribution<malbolge::word> distribution(min, max);
+        std::vector<malbolge::word> words(input_count);
+        std::ranges::generate(words, [&] { return distribution(engine); });
+        return words;
+    }
+
+    /**
+     * @brief 固定したシードで探索を進め、その途中の世代を集める
+     * @param seed 乱数のシード
+     * @param generations 進める世代数
+     * @return 各世代の記述子の配列。探索が途中で終わった場合はそこまで。
+     */
+    std::vector<std::vector<malbolge_machine_state::descriptor>> collect_generations(
+        const std::uint32_t seed,
+        const std::size_t generations
+    )
+    {
+        malbolge_search::searcher bs(
+            search_beam_width, malbolge_search::generation_function(std::string(target)),
+            malbolge_search::scoring_function(), malbolge_machine_state::descriptor(), seed
+        );
+        std::vector<std::vector<malbolge_machine_state::descriptor>> history;
+        while (history.size() < generations && !bs.get_current_generation().empty()) {
+            history.emplace_back(std::begin(bs.get_current_generation()), std::end(bs.get_current_generation()));
+            std::vector<malbolge_machine_state::descriptor> found;
+            if (bs.search_current_generation(std::back_inserter(found))) {
+                break;
+            }
+        }
+        return history;
+    }
+
+    /**
+     * @brief 算術演算と命令表のベンチマーク
+     */
+    void bench_alu(const auto &selected)
+    {
+        std::mt19937 engine(input_seed);
+        const auto xs = random_words(engine, 0, malbolge::word_size - 1);
+        const auto ys = random_words(engine, 0, malbolge::word_size - 1);
+        const auto graphics = random_words(engine, malbolge::graphic_min, malbolge::graphic_min + malbolge::graphic_count - 1);
+        std::vector<malbolge::packed_word> packed_xs, packed_ys;
+        std::ranges::transform(xs, std::back_inserter(packed_xs), malbolge::pack);
+        std::ranges::transform(ys, std::back_inserter(packed_ys), malbolge::pack);
+        if (selected("malbolge::op")) {
+            benchmark::run("malbolge::op", [&](const std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    benchmark::do_not_optimize(malbolge::op(xs[i & (input_count - 1)], ys[i & (input_count - 1)]));
+                }
+            });
+        }
+        if (selected("malbolge::op_each")) {
+            // 一回の反復を一ワード分として、input_count ワードずつまとめて計算する
+            std::vector<malbolge::word> results(input_count);
+            benchmark::run("malbolge::op_each", [&](const std::size_t n) {
+                for (std::size_t done = 0; done < n; done += input_count) {
+                    const auto count = std::min(n - done, input_count);
+                    malbolge::op_each(std::span(xs).first(count), ys[done / input_count & (input_count - 1)], std::span(results).first(count));
+                    benchmark::do_not_optimize(results.data());
+                }
+            });
+        }
+        if (selected("malbolge::packed_op")) {
+            benchmark::run("malbolge::packed_op", [&](const std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    benchmark::do_not_optimize(malbolge::packed_op(packed_xs[i & (input_count - 1)], packed_ys[i & (input_count - 1)]));
+                }
+            });
+        }
+        if (selected("malbolge::trit_rotate_right")) {
+            benchmark::run("malbolge::trit_rotate_right", [&](const std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    benchmark::do_not_optimize(malbolge::trit_rotate_right(xs[i & (input_count - 1)]));
+                }
+            });
+        }
+        if (selected("malbolge::decode_operation")) {
+            benchmark::run("malbolge::decode_operation", [&](const std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    benchmark::do_not_optimize(malbolge::decode_operation(xs[i & (input_count - 1)], graphics[i & (input_count - 1)]));
+                }
+            });
+        }
+        if (selected("malbolge::encrypt_code")) {
+            benchmark::run("malbolge::encrypt_code", [&](const std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    benchmark::do_not_optimize(malbolge::encrypt_code(graphics[i & (input_count - 1)]));
+                }
+            });
+        }
+    }
+
+    /**
+     * @brief 仮想機械の状態のベンチマーク
+     * @note 固定したシードの探索で得られた状態を入力とする。
+     */
+    void bench_machine_state(const auto &selected)
+    {
+        const auto history = collect_generations(search_seeds.front(), 64);
+        if (
+            selected("malbolge_machine_state::descriptor::materialize") ||
+            selected("malbolge_machine_state::process")
+        ) {
+            const auto &frontier = history.back();
+            if (selected("malbolge_machine_state::descriptor::materialize")) {
+                benchmark::run("malbolge_machine_state::descriptor::materialize", [&](const std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        benchmark::do_not_optimize(frontier[i % frontier.size()].materialize());
+                    }
+                });
+            }
+            if (selected("malbolge_machine_state::process")) {
+                // process() を直接呼べないので、最後の世代の各状態を実体化して実行し、一ステップあたりの時間を求める
+                benchmark::run_samples("malbolge_machine_state::process", [&] {
+                    std::size_t steps = 0;
+                    const auto start = std::chrono::steady_clock::now();
+                    auto elapsed = std::chrono::steady_clock::duration::zero();
+                    while (elapsed < benchmark::min_sample_time) {
+                        for (const auto &node : frontier) {
+                            const auto state = node.materialize();
+                            // 暴走する状態で止まらないよう、generation_function と同じ上限と循環の検出を用いる
+                            // StepBudgetExceeded や CycleDetected を含め、出力以外の理由で中断したら次の状態に移る
+                            while (state->run(malbolge_search::default_step_budget, true).status == malbolge_machine_state::ExecutionStatus::OutputProduced) {
+                                ;
+                            }
+                            steps += state->executed_steps();
+                        }
+                        elapsed = std::chrono::steady_clock::now() - start;
+                    }
+                    return benchmark::sample{std::chrono::duration<double, std::nano>(elapsed).count(), steps};
+                });
+            }
+        }
+        // 第一世代は初期状態だけなので、何か書き込まれた第二世代から測る
+        for (const auto g : {std::size_t{2}, std::size_t{8}, std::size_t{32}, history.size()}) {
+            const auto state = history[std::min(g, history.size()) - 1].front().materialize();
+            const auto depth = std::to_string(state->depth);
+            const auto check_memory_name = "malbolge_machine_state::check_memory/depth=" + depth;
+            if (selected(check_memory_name)) {
+                // 書き込まれたアドレスの範囲から読み出す
+                const auto code_length = std::max<std::size_t>(state->generate_code().length(), 1);
+                std::mt19937 engine(input_seed);
+                const auto addresses = random_words(engine, 0, static_cast<malbolge::word>(code_length - 1));
+                benchmark::run(check_memory_name, [&](const std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        benchmark::do_not_optimize(state->check_memory(addresses[i & (input_count - 1)]));
+                    }
+                });
+            }
+            const auto generate_code_name = "malbolge_machine_state::generate_code/depth=" + depth;
+            if (selected(generate_code_name)) {
+                benchmark::run(generate_code_name, [&](const std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        benchmark::do_not_optimize(state->generate_code());
+                    }
+                });
+            }
+        }
+    }
+
+    /**
+     * @brief 探索の一世代分のベンチマーク
+     * @note 操作回数は展開したノードの数とする。
+     */
+    void bench_search(const auto &selected)
+    {
+        for (const auto seed : search_seeds) {
+            const auto name = "beam_searcher::search_current_generation/seed=" + std::to_string(seed);
+            if (!selected(name)) {
+                continue;
+            }
+            benchmark::run_samples(name, [seed] {
+                malbolge_search::searcher bs(
+                    search_beam_width, malbolge_search::generation_function(std::string(target)),
+                    malbolge_search::scoring_function(), malbolge_machine_state::descriptor(), seed,
+                    1, malbolge_search::hash_function()
+                );
+                std::vector<malbolge_machine_state::descriptor> found;
+                for (std::size_t i = 0; i < search_warmup_generations; ++i) {
+                    bs.search_current_generation(std::back_inserter(found));
+                }
+                const auto expanded = bs.get_current_generation().size();
+                const auto start = std::chrono::steady_clock::now();
+                bs.search_current_generation(std::back_inserter(found));
+                const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+                return benchmark::sample{elapsed.count(), expanded};
+            });
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::vector<std::string_view> filters(argv + 1, argv + argc);
+    const auto selected = [&filters](const std::string_view name) {
+        return filters.empty() || std::ranges::any_of(filters, [name](const auto filter) {
+            return name.find(filter) != std::string_view::npos;
+        });
+    };
+    bench_alu(selected);
+    bench_machine_state(selected);
+    bench_search(selected);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,375 @@
+/**
+ * @file search.cpp
+ * @brief 探索全体のベンチマークの main 関数
+ * @detail シード、ビーム幅、目標文字列の組み合わせごとに探索を最後まで行い、
+ * @detail 所要時間、世代数、最大常駐セットサイズ、毎秒の展開ノード数、成否を CSV か JSON Lines で出力する。
+ * @detail 最大常駐セットサイズを一回ごとに測るため、各探索は fork() した子プロセスで行う。
+ * @detail 最後に目標文字列とビーム幅の組ごとに、成功率と各値の平均を集計した行を出力する。
+ */
+
+#include "malbolge_machine_state.hpp"
+#include "malbolge_search.hpp"
+#include "slab_arena.hpp"
+#include "target_trie.hpp"
+#include "reachability_table.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+namespace {
+    /**
+     * @brief 実行する探索の組み合わせ
+     */
+    struct sweep_config {
+        //! 乱数のシード
+        std::vector<std::uint32_t> seeds = {1, 2, 3};
+
+        //! ビーム幅
+        std::vector<std::size_t> beam_widths = {1000, 10000};
+
+        //! 目標文字列
+        std::vector<std::string> targets = {"Hello World"};
+
+        //! 探索に用いるスレッド数
+        std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        //! 打ち切るまでの世代数
+        std::size_t max_generations = 1000;
+
+        //! スコア関数のヒューリスティック項の重み。0 ならば用いない。
+        int heuristic_weight = 0;
+
+        //! 到達可能性の表を保存するファイル
+        std::string heuristic_cache = "reachability.bin";
+
+        //! 到達可能性の表。heuristic_weight > 0 のとき、子プロセスを作る前に読み込んでおく。
+        std::shared_ptr<const reachability_table> table;
+
+        //! JSON Lines で出力するか否か。false ならば CSV で出力する。
+        bool outputs_json = false;
+    };
+
+    /**
+     * @brief 一回の探索の結果
+     * @note 子プロセスからパイプでそのまま送るので、トリビアルにコピーできる型だけを持つ。
+     */
+    struct run_result {
+        //! 解が見つかったか否か
+        bool success;
+
+        //! 探索を終えた時点での世代カウント
+        std::size_t generations;
+
+        //! 展開したノードの数
+        std::size_t nodes_expanded;
+
+        //! 探索にかかった時間（秒）
+        double wall_seconds;
+
+        //! 最大常駐セットサイズ（KiB）
+        long peak_rss_kib;
+    };
+
+    /**
+     * @brief 探索を一回行う
+     * @param target 目標文字列
+     * @param beam_width ビーム幅
+     * @param seed 乱数のシード
+     * @param config 実行する探索の組み合わせ
+     * @return 探索の結果。peak_rss_kib は設定しない。
+     */
+    run_result search_once(
+        const std::string &target,
+        const std::size_t beam_width,
+        const std::uint32_t seed,
+        const sweep_config &config
+    )
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto targets = std::make_shared<const target_trie>(std::vector<std::string>{target});
+        malbolge_search::searcher bs(
+            beam_width, malbolge_search::generation_function(targets),
+            config.table
+                ? malbolge_search::scoring_function(config.table, targets, config.heuristic_weight)
+                : malbolge_search::scoring_function(),
+            malbolge_machine_state::descriptor(),
+            seed, config.thread_count, malbolge_search::hash_function()
+        );
+        run_result result{false, 0, 0, 0, 0};
+        while (!bs.get_current_generation().empty() && bs.get_generation() <= config.max_generations) {
+            result.nodes_expanded += bs.get_current_generation().size();
+            slab_arena::next_generation();
+            std::vector<malbolge_machine_state::descriptor> found;
+            if (bs.search_current_generation(std::back_inserter(found))) {
+                result.success = true;
+                break;
+            }
+        }
+        result.generations = bs.get_generation();
+        result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    /**
+     * @brief 子プロセスで探索を一回行う
+     * @return 探索の結果
+     * @throws std::runtime_error 子プロセスの作成もしくは結果の受け取りに失敗した
+     */
+    run_result search_in_child(
+        const std::string &target,
+        const std::size_t beam_width,
+        const std::uint32_t seed,
+        const sweep_config &config
+    )
+    {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::runtime_error("pipe() failed.");
+        }
+        const auto pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error("fork() failed.");
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            const auto result = search_once(target, beam_width, seed, config);
+            const auto written = write(fds[1], &result, sizeof(result));
+            _exit(written == sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(fds[1]);
+        run_result result;
+        const auto received = read(fds[0], &result, sizeof(result));
+        close(fds[0]);
+        int status = 0;
+        rusage usage{};
+        wait4(pid, &status, 0, &usage);
+        if (received != sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            throw std::runtime_error("search process failed.");
+        }
+        // Linux では ru_maxrss は KiB 単位
+        result.peak_rss_kib = usage.ru_maxrss;
+        return result;
+    }
+
+    /**
+     * @brief JSON の文字列リテラルとして書き出す
+     */
+    std::string quote_json(const std::string_view s)
+    {
+        std::string quoted = "\"";
+        for (const auto c : s) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    /**
+     * @brief CSV のフィールドとして書き出す
+     */
+    std::string quote_csv(const std::string_view s)
+    {
+        std::string quoted = "\"";
+        for (const auto c : s) {
+            if (c == '"') {
+                quoted += '"';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    /**
+     * @brief 一行分の結果を出力する
+     * @param config 実行する探索の組み合わせ
+     * @param kind run（一回の探索）もしくは summary（集計）
+     * @param target 目標文字列
+     * @param beam_width ビーム幅
+     * @param seed シード。集計の行では空
+     * @param success 成否。集計の行では成功率
+     * @param generations 以降の引数は一回の探索の値。集計の行では平均
+     */
+    void print_row(
+        const sweep_config &config,
+        const std::string_view kind,
+        const std::string &target,
+        const std::size_t beam_width,
+        const std::string &seed,
+        const double success,
+        const double generations,
+        const double nodes_expanded,
+        const double wall_seconds,
+        const double peak_rss_kib
+    )
+    {
+        const auto nodes_per_second = wall_seconds > 0 ? nodes_expanded / wall_seconds : 0;
+        if (config.outputs_json) {
+            std::cout << "{\"kind\":" << quote_json(kind)
+                      << ",\"target\":" << quote_json(target)
+                      << ",\"beam_width\":" << beam_width
+                      << ",\"seed\":" << (seed.empty() ? "null" : seed)
+                      << ",\"threads\":" << config.thread_count
+                      << ",\"heuristic\":" << config.heuristic_weight
+                      << ",\"success\":" << success
+                      << ",\"generations\":" << generations
+                      << ",\"wall_seconds\":" << wall_seconds
+                      << ",\"nodes_expanded\":" << nodes_expanded
+                      << ",\"nodes_per_second\":" << nodes_per_second
+                      << ",\"peak_rss_kib\":" << peak_rss_kib
+                      << "}\n";
+        } else {
+            std::cout << kind << ',' << quote_csv(target) << ',' << beam_width << ',' << seed << ','
+                      << config.thread_count << ',' << config.heuristic_weight << ',' << success << ',' << generations << ','
+                      << wall_seconds << ',' << nodes_expanded << ',' << nodes_per_second << ','
+                      << peak_rss_kib << '\n';
+        }
+        std::cout << std::flush;
+    }
+
+    /**
+     * @brief カンマ区切りの数値の列を読む
+     * @throws std::invalid_argument 数値として読めない要素がある
+     */
+    template <class T>
+    std::vector<T> parse_list(const std::string_view list)
+    {
+        std::vector<T> values;
+        std::istringstream iss{std::string(list)};
+        for (std::string item; std::getline(iss, item, ',');) {
+            values.push_back(static_cast<T>(std::stoull(item)));
+        }
+        return values;
+    }
+
+    /**
+     * @brief コマンドライン引数を読む
+     * @throws std::invalid_argument 解釈できない引数があるか、シードの列もしくはビーム幅の列が空であるか、ビーム幅かスレッド数がゼロ
+     * @note 探索器はビーム幅やスレッド数がゼロだと子プロセスの中で例外を投げるので、ここで弾く。
+     */
+    sweep_config parse_arguments(const std::vector<std::string_view> &arguments)
+    {
+        sweep_config config;
+        bool targets_given = false;
+        for (std::size_t i = 0; i < arguments.size(); ++i) {
+            const auto option = arguments[i];
+            if (option == "--json") {
+                config.outputs_json = true;
+                continue;
+            }
+            if (option == "--csv") {
+                config.outputs_json = false;
+                continue;
+            }
+            if (i + 1 >= arguments.size()) {
+                throw std::invalid_argument("missing value for " + std::string(option));
+            }
+            const auto value = arguments[++i];
+            if (option == "--seeds") {
+                config.seeds = parse_list<std::uint32_t>(value);
+            } else if (option == "--widths") {
+                config.beam_widths = parse_list<std::size_t>(value);
+            } else if (option == "--target") {
+                if (!std::exchange(targets_given, true)) {
+                    config.targets.clear();
+                }
+                config.targets.emplace_back(value);
+            } else if (option == "--threads") {
+                config.thread_count = std::stoull(std::string(value));
+            } else if (option == "--max-generations") {
+                config.max_generations = std::stoull(std::string(value));
+            } else if (option == "--heuristic") {
+                config.heuristic_weight = std::stoi(std::string(value));
+            } else if (option == "--heuristic-cache") {
+                config.heuristic_cache = value;
+            } else {
+                throw std::invalid_argument("unknown option " + std::string(option));
+            }
+        }
+        if (config.seeds.empty()) {
+            throw std::invalid_argument("no seeds given");
+        }
+        if (config.beam_widths.empty() || std::ranges::find(config.beam_widths, std::size_t{0}) != std::end(config.beam_widths)) {
+            throw std::invalid_argument("beam widths must be positive");
+        }
+        if (config.thread_count == 0) {
+            throw std::invalid_argument("thread count must be positive");
+        }
+        return config;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    sweep_config config;
+    try {
+        config = parse_arguments(std::vector<std::string_view>(argv + 1, argv + argc));
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n'
+                  << "usage: " << argv[0]
+                  << " [--seeds 1,2,3] [--widths 1000,10000] [--target STRING]... [--threads N] [--max-generations N] [--heuristic WEIGHT [--heuristic-cache FILE]] [--csv | --json]\n";
+        return EXIT_FAILURE;
+    }
+    if (config.heuristic_weight > 0) {
+        config.table = std::make_shared<const reachability_table>(reachability_table::load_or_build(config.heuristic_cache));
+    }
+    // 展開ノード数などを指数表記にせず出力する
+    std::cout.precision(12);
+    if (!config.outputs_json) {
+        std::cout << "kind,target,beam_width,seed,threads,heuristic,success,generations,wall_seconds,nodes_expanded,nodes_per_second,peak_rss_kib\n";
+    }
+    for (const auto &target : config.targets) {
+        for (const auto beam_width : config.beam_widths) {
+            std::vector<run_result> results;
+            for (const auto seed : config.seeds) {
+                run_result result;
+                try {
+                    result = search_in_child(target, beam_width, seed, config);
+                } catch (const std::exception &e) {
+                    std::cerr << e.what() << " (target " << quote_csv(target) << ", beam width " << beam_width << ", seed " << seed << ")\n";
+                    return EXIT_FAILURE;
+                }
+                print_row(
+                    config, "run", target, beam_width, std::to_string(seed), result.success, static_cast<double>(result.generations),
+                    static_cast<double>(result.nodes_expanded), result.wall_seconds, static_cast<double>(result.peak_rss_kib)
+                );
+                results.push_back(result);
+            }
+            if (results.empty()) {
+                continue;
+            }
+            const auto mean = [&results](const auto projection) {
+                double sum = 0;
+                for (const auto &result : results) {
+                    sum += static_cast<double>(projection(result));
+                }
+                return sum / static_cast<double>(results.size());
+            };
+            print_row(
+                config, "summary", target, beam_width, "",
+                mean([](const run_result &r) { return r.success; }),
+                mean([](const run_result &r) { return r.generations; }),
+                mean([](const run_result &r) { return r.nodes_expanded; }),
+                mean([](const run_result &r) { return r.wall_seconds; }),
+                mean([](const run_result &r) { return r.peak_rss_kib; })
+            );
+        }
+    }
+    return EXIT_SUCCESS;
+}
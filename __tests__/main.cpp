@@ -1,21 +1,170 @@
 #include "malbolge_machine.hpp"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <utility>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
 
+namespace {
+    /**
+     * @brief 一つのプログラムの検証結果
+     */
+    struct verdict {
+        //! 出力が期待通りで、正常終了したか否か
+        bool passed = false;
+
+        //! 失敗の理由。passed ならば空
+        std::string reason;
+
+        //! 実際の出力
+        std::string output;
+    };
+
+    /**
+     * @brief 一つのプログラムを実行し、期待される出力と比べる
+     * @param code ソースコード
+     * @param expected 期待される出力
+     * @param ignores_case 大文字・小文字の違いを無視するか否か
+     * @param max_steps 実行する命令数の上限
+     * @return 検証結果
+     */
+    verdict verify(const std::string &code, const std::string &expected, const bool ignores_case, const std::size_t max_steps)
+    {
+        verdict v;
+        try {
+            std::istringstream iss(code);
+            malbolge_machine mm(iss);
+            if (!mm.run(v.output, max_steps)) {
+                v.reason = "did not exit";
+                return v;
+            }
+        } catch (const std::runtime_error &e) {
+            v.reason = e.what();
+            return v;
+        }
+        const auto equals = [ignores_case](const unsigned char x, const unsigned char y) {
+            return ignores_case ? toupper(x) == toupper(y) : x == y;
+        };
+        v.passed = std::ranges::equal(v.output, expected, equals);
+        if (!v.passed) {
+            v.reason = "unexpected output";
+        }
+        return v;
+    }
+
+    /**
+     * @brief ファイルの各行のプログラムを全てのコアで検証し、結果を行の順に出力する
+     * @param codes ソースコード
+     * @param line_numbers codes の各要素があった行の番号
+     * @return 全て成功したか否か
+     */
+    bool verify_batch(
+        const std::vector<std::string> &codes,
+        const std::vector<std::size_t> &line_numbers,
+        const std::string &expected,
+        const bool ignores_case,
+        const std::size_t max_steps,
+        const std::size_t thread_count
+    )
+    {
+        std::vector<verdict> verdicts(codes.size());
+        std::atomic<std::size_t> next = 0;
+        {
+            std::vector<std::jthread> workers;
+            for (std::size_t t = 0; t < thread_count; ++t) {
+                workers.emplace_back([&] {
+                    for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < codes.size();) {
+                        verdicts[i] = verify(codes[i], expected, ignores_case, max_steps);
+                    }
+                });
+            }
+        }
+        std::string report;
+        std::size_t passed = 0;
+        for (std::size_t i = 0; i < verdicts.size(); ++i) {
+            if (verdicts[i].passed) {
+                ++passed;
+                report += "PASS " + std::to_string(line_numbers[i]) + '\n';
+            } else {
+                report += "FAIL " + std::to_string(line_numbers[i]) + ": " + verdicts[i].reason + " [" + verdicts[i].output + "]\n";
+            }
+        }
+        std::cout << report << passed << " / " << verdicts.size() << " passed" << std::endl;
+        return passed == verdicts.size();
+    }
+}
+
+/*
+ * 引数にファイルを一つ与えると、そのプログラムを標準入出力につないで実行する。
+ * --batch FILE --expect STRING と与えると、FILE の一行を一つのプログラムとして全て実行し、
+ * 出力が STRING と一致して正常終了したかを行ごとに PASS / FAIL で出力する。全て成功すれば終了コードは 0 となる。
+ * --ignore-case で大文字・小文字の違いを無視し、--threads N で用いるスレッド数を、
+ * --max-steps N で一つのプログラムが実行してよい命令数の上限（既定値は 10000000）を指定できる。
+ */
 int main(int argc, char *argv[])
 {
-    if (argc != 2) {
+    if (argc == 2) {
+        std::ifstream ifs{argv[1]};
+        if (!ifs) {
+            std::cerr << "can't open file" << std::endl;
+            return EXIT_FAILURE;
+        }
+        malbolge_machine mm(ifs);
+        while (!mm.exec_one_step(std::cin, std::cout)) {
+            ;
+        }
+        return EXIT_SUCCESS;
+    }
+    const char *batch_file = nullptr;
+    const char *expected = nullptr;
+    bool ignores_case = false;
+    std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t max_steps = 10000000;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view option = argv[i];
+        if (option == "--batch" && i + 1 < argc) {
+            batch_file = argv[++i];
+        } else if (option == "--expect" && i + 1 < argc) {
+            expected = argv[++i];
+        } else if (option == "--ignore-case") {
+            ignores_case = true;
+        } else if (option == "--threads" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            thread_count = std::atoi(argv[++i]);
+        } else if (option == "--max-steps" && i + 1 < argc && std::atoll(argv[i + 1]) > 0) {
+            max_steps = std::atoll(argv[++i]);
+        } else {
+            batch_file = nullptr;
+            break;
+        }
+    }
+    if (!batch_file || !expected) {
         std::cerr << "invalid command line" << std::endl;
         return EXIT_FAILURE;
     }
-    std::ifstream ifs{argv[1]};
+    std::ifstream ifs{batch_file};
     if (!ifs) {
         std::cerr << "can't open file" << std::endl;
         return EXIT_FAILURE;
     }
-    malbolge_machine mm(ifs);
-    while (!mm.exec_one_step(std::cin, std::cout)) {
-        ;
+    // 空行は飛ばす
+    std::vector<std::string> codes;
+    std::vector<std::size_t> line_numbers;
+    std::size_t line_number = 0;
+    for (std::string line; std::getline(ifs, line);) {
+        ++line_number;
+        if (!std::ranges::all_of(line, [](const unsigned char x) { return isspace(x); })) {
+            codes.push_back(std::move(line));
+            line_numbers.push_back(line_number);
+        }
     }
-    return EXIT_SUCCESS;
+    return verify_batch(codes, line_numbers, expected, ignores_case, max_steps, thread_count) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -18,54 +18,94 @@ malbolge_machine::malbolge_machine(std::istream &is)
             throw std::runtime_error("input file too long");
         }
     }
-    for (; itr != std::end(memory); ++itr) {
-        *itr = malbolge::op(*(itr - 1), *(itr - 2));
+    filled = itr - std::begin(memory);
+    if (filled < 2) {
+        throw std::runtime_error("input file too short");
     }
+    fill_seed[0] = memory[filled - 1];
+    fill_seed[1] = memory[filled - 2];
 }
 
 /**
- * @copydoc malbolge_machine::malbolge_machine(std::istream &is, std::ostream &os)
+ * @copydoc malbolge_machine::step(Input, Output)
  */
-bool malbolge_machine::exec_one_step(std::istream &is, std::ostream &os)
+template <class Input, class Output>
+malbolge_machine::StepResult malbolge_machine::step(Input input, Output output)
 {
-    const auto opcode = malbolge::decode_operation(c, memory[c]);
+    const auto opcode = malbolge::decode_operation(c, at(c));
     if (!opcode) {
-        return false;
+        return StepResult::Stalled;
     }
     switch (*opcode) {
         case malbolge::Instruction::MovD:
-            d = memory[d];
+            d = at(d);
             break;
         case malbolge::Instruction::Jmp:
-            c = memory[d];
+            c = at(d);
             break;
         case malbolge::Instruction::RotR:
-            a = memory[d] = malbolge::trit_rotate_right(memory[d]);
+            a = at(d) = malbolge::trit_rotate_right(at(d));
             break;
         case malbolge::Instruction::Op:
-            a = memory[d] = malbolge::op(a, memory[d]);
+            a = at(d) = malbolge::op(a, at(d));
             break;
         case malbolge::Instruction::Out:
-            os.put(static_cast<unsigned char>(a));
+            output(static_cast<unsigned char>(a));
             break;
         case malbolge::Instruction::In:
-            {
-                const auto x = is.get();
-                a = (is.eof() ? 59048 : x);
-            }
+            a = input();
             break;
         case malbolge::Instruction::Exit:
-            return true;
+            return StepResult::Exited;
         case malbolge::Instruction::Nop:
             ;
             break;
     }
-    if (const auto encrypted = malbolge::encrypt_code(memory[c])) {
-        memory[c] = *encrypted;
+    if (const auto encrypted = malbolge::encrypt_code(at(c))) {
+        at(c) = *encrypted;
     } else {
         throw std::runtime_error("memory[c] is not a graphical ASCII");
     }
     c = (c + 1) % malbolge::word_size;
     d = (d + 1) % malbolge::word_size;
+    return StepResult::Continued;
+}
+
+/**
+ * @copydoc malbolge_machine::exec_one_step(std::istream &, std::ostream &)
+ */
+bool malbolge_machine::exec_one_step(std::istream &is, std::ostream &os)
+{
+    const auto input = [&is]() -> malbolge::word {
+        const auto x = is.get();
+        return is.eof() ? 59048 : x;
+    };
+    const auto output = [&os](const unsigned char x) {
+        os.put(x);
+    };
+    return step(input, output) == StepResult::Exited;
+}
+
+/**
+ * @copydoc malbolge_machine::run(std::string &, const std::size_t)
+ */
+bool malbolge_machine::run(std::string &output, const std::size_t max_steps)
+{
+    const auto input = []() -> malbolge::word {
+        return 59048;
+    };
+    const auto append = [&output](const unsigned char x) {
+        output += static_cast<char>(x);
+    };
+    for (std::size_t i = 0; i < max_steps; ++i) {
+        switch (step(input, append)) {
+            case StepResult::Continued:
+                break;
+            case StepResult::Exited:
+                return true;
+            case StepResult::Stalled:
+                return false;
+        }
+    }
     return false;
 }
@@ -1,15 +1,32 @@
 #include "../malbolge.hpp"
 #include <istream>
 #include <ostream>
+#include <string>
+#include <cstddef>
 
 /**
  * @brief Malbolge 仮想機械の実装
  */
 class malbolge_machine final {
 private:
-    //! メモリ
+    /**
+     * @brief 一度の実行の結果
+     */
+    enum class StepResult {
+        Continued,  ///< 次の命令に進んだ
+        Exited,     ///< プログラムが終了した
+        Stalled     ///< 命令のデコードに失敗し、何もしなかった
+    };
+
+    //! メモリ。filled 番地以降はまだ値を持たない。
     malbolge::word memory[malbolge::word_size];
 
+    //! 値を持つメモリの数。ソースコードより後ろは、アクセスされたアドレスまでを順に埋める。
+    std::size_t filled = 0;
+
+    //! filled - 1 番地と filled - 2 番地に読み込み時点で置かれた値。プログラムがその後に書き換えても変わらない。
+    malbolge::word fill_seed[2] = {0, 0};
+
     //! A レジスタ
     malbolge::word a = 0;
 
@@ -19,6 +36,33 @@ private:
     //! D レジスタ
     malbolge::word d = 0;
 
+    /**
+     * @param address アドレス
+     * @return address 番地のメモリ
+     * @note まだ値を持たなければ、直前の二つの op 演算の結果で address 番地まで埋める。
+     * @note 埋める値は fill_seed から求めるので、読み込み後にメモリへ書き込まれた値には左右されない。
+     */
+    inline malbolge::word &at(const malbolge::word address)
+    {
+        for (; filled <= address; ++filled) {
+            const auto x = malbolge::op(fill_seed[0], fill_seed[1]);
+            memory[filled] = x;
+            fill_seed[1] = fill_seed[0];
+            fill_seed[0] = x;
+        }
+        return memory[address];
+    }
+
+    /**
+     * @brief 命令を一度実行する
+     * @param input 入力から一文字読む関数。入力の終わりでは 59048 を返す。
+     * @param output 一文字出力する関数
+     * @return 実行の結果
+     * @throw std::runtime_error メモリの暗号化に失敗した
+     */
+    template <class Input, class Output>
+    StepResult step(Input input, Output output);
+
 public:
     /**
      * @param is ソースコードを取得する入力ストリーム
@@ -35,4 +79,14 @@ public:
      * @note 命令のデコードに失敗した場合は何もせずに false を返却する。
      */
     bool exec_one_step(std::istream &is, std::ostream &os);
+
+    /**
+     * @brief 入力を与えずに、終了するか命令数の上限に達するまで実行する
+     * @param output 出力を追記する文字列
+     * @param max_steps 実行する命令数の上限
+     * @return プログラムが終了したか否か
+     * @throw std::runtime_error メモリの暗号化に失敗した
+     * @note 命令のデコードに失敗した場合は、それ以上進まないので直ちに false を返却する。
+     */
+    bool run(std::string &output, const std::size_t max_steps);
 };
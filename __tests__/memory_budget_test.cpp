@@ -0,0 +1,81 @@
+/**
+ * @file memory_budget_test.cpp
+ * @brief memory_budget が slab_arena 以外のヒープの増加でもビーム幅を縮めることを確かめる
+ */
+
+#include "memory_budget.hpp"
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    //! 失敗した検査の数
+    int failures = 0;
+
+    //! 上限に対して確保する大きさ
+    constexpr std::size_t block_size = 64 << 20;
+
+    //! ビーム幅の初期値
+    constexpr std::size_t beam_width = 10000;
+
+    /**
+     * @brief 条件が成り立たなければ失敗として報告する
+     * @param condition 条件
+     * @param description 検査の説明
+     */
+    void expect(const bool condition, const std::string_view description)
+    {
+        if (!condition) {
+            std::cerr << "FAIL: " << description << std::endl;
+            ++failures;
+        }
+    }
+
+    /**
+     * @brief 常駐するよう書き込んだ領域を確保する
+     * @return 確保した領域
+     */
+    std::unique_ptr<char[]> touch_block()
+    {
+        auto block = std::make_unique<char[]>(block_size);
+        std::memset(block.get(), 1, block_size);
+        return block;
+    }
+
+    /**
+     * @brief スラブ以外から確保した領域が残っていれば、ビーム幅を縮める
+     */
+    void check_retained_heap()
+    {
+        memory_budget budget(memory_budget(1, 1, 1).usage() + block_size, 1, beam_width);
+        const auto block = touch_block();
+        expect(budget.next_beam_width(beam_width) < beam_width, "beam kept its width with the heap over the limit");
+    }
+
+    /**
+     * @brief 世代の途中で確保して捨てた領域も observe() で測っていれば、ビーム幅を縮める
+     */
+    void check_transient_peak()
+    {
+        memory_budget budget(memory_budget(1, 1, 1).usage() + block_size, 1, beam_width);
+        {
+            const auto block = touch_block();
+            budget.observe();
+        }
+        expect(budget.next_beam_width(beam_width) < beam_width, "beam kept its width after a transient peak over the limit");
+        expect(budget.next_beam_width(beam_width) >= beam_width, "peak outlived the generation that observed it");
+    }
+}
+
+int main()
+{
+    check_retained_heap();
+    check_transient_peak();
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "memory_budget: OK" << std::endl;
+}
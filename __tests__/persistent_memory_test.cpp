@@ -0,0 +1,108 @@
+/**
+ * @file persistent_memory_test.cpp
+ * @brief persistent_memory のコピーが互いの書き込みから独立していることを確かめる
+ */
+
+#include "persistent_memory.hpp"
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <cstdlib>
+
+namespace {
+    //! 失敗した検査の数
+    int failures = 0;
+
+    /**
+     * @brief 条件が成り立たなければ失敗として報告する
+     * @param condition 条件
+     * @param description 検査の説明
+     */
+    void expect(const bool condition, const std::string_view description)
+    {
+        if (!condition) {
+            std::cerr << "FAIL: " << description << std::endl;
+            ++failures;
+        }
+    }
+
+    /**
+     * @brief 書き込みを木へ反映した状態でコピーし、双方向に独立していることを確かめる
+     * @param commits コピーの前後に commit() を呼ぶか否か
+     */
+    void check_isolation(const bool commits)
+    {
+        persistent_memory a;
+        for (malbolge::word address = 0; address < 200; ++address) {
+            a.set(address, static_cast<malbolge::word>(address + 1));
+        }
+        a.commit();
+        a.set(5, 100);
+        if (commits) {
+            a.commit();
+        }
+        const auto digest_before = a.digest();
+        persistent_memory b(a);
+        // コピー元への書き込みはコピー先から見えない
+        a.set(5, 111);
+        a.set(6, 200);
+        a.set(300, 7);
+        if (commits) {
+            a.commit();
+        }
+        expect(b.get(5) == std::optional<malbolge::word>(100), "copy sees source write to an existing word");
+        expect(b.get(6) == std::optional<malbolge::word>(7), "copy sees source overwrite");
+        expect(!b.get(300), "copy sees source write to a new leaf");
+        expect(b.digest() == digest_before, "copy digest changes with source writes");
+        // コピー先への書き込みはコピー元から見えない
+        b.set(7, 222);
+        b.set(400, 9);
+        if (commits) {
+            b.commit();
+        }
+        expect(a.get(7) == std::optional<malbolge::word>(8), "source sees copy write to an existing word");
+        expect(!a.get(400), "source sees copy write to a new leaf");
+        expect(a.get(5) == std::optional<malbolge::word>(111) && a.get(300) == std::optional<malbolge::word>(7), "source loses its own writes");
+        // 代入でも同じ
+        persistent_memory c;
+        c = a;
+        a.set(8, 333);
+        c.set(9, 444);
+        if (commits) {
+            a.commit();
+            c.commit();
+        }
+        expect(c.get(8) == std::optional<malbolge::word>(9), "assigned copy sees source write");
+        expect(a.get(9) == std::optional<malbolge::word>(10), "source sees assigned copy write");
+    }
+
+    /**
+     * @brief 内容が等しければハッシュ値が等しいことを確かめる
+     */
+    void check_digest()
+    {
+        persistent_memory a, b;
+        a.set(1, 10);
+        a.set(2, 20);
+        a.commit();
+        b.set(2, 20);
+        b.set(1, 11);
+        b.set(1, 10);
+        expect(a.digest() == b.digest(), "digest depends on write order");
+        persistent_memory c(a);
+        c.set(3, 30);
+        c.commit();
+        expect(a.digest() != c.digest(), "digest ignores a write to a copy");
+    }
+}
+
+int main()
+{
+    check_isolation(true);
+    check_isolation(false);
+    check_digest();
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "persistent_memory: OK" << std::endl;
+}
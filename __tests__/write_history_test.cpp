@@ -0,0 +1,111 @@
+/**
+ * @file write_history_test.cpp
+ * @brief write_history が分岐した系列の間で平坦化した接頭辞を共有することを確かめる
+ */
+
+#include "write_history.hpp"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+#include <cstdlib>
+
+namespace {
+    //! 失敗した検査の数
+    int failures = 0;
+
+    /**
+     * @brief 条件が成り立たなければ失敗として報告する
+     * @param condition 条件
+     * @param description 検査の説明
+     */
+    void expect(const bool condition, const std::string_view description)
+    {
+        if (!condition) {
+            std::cerr << "FAIL: " << description << std::endl;
+            ++failures;
+        }
+    }
+
+    /**
+     * @brief 探索と同じく、書き込むたびに平坦化を試みながら書き込みを追記する
+     * @param history 追記する履歴
+     * @param expected 追記した書き込みを記録する配列
+     * @param first 最初の書き込みのアドレス
+     * @param count 書き込みの数
+     */
+    void extend(write_history &history, std::vector<write_history::write> &expected, const malbolge::word first, const std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            const write_history::write w = {static_cast<malbolge::word>(first + i), static_cast<malbolge::word>(i % 94 + 33)};
+            history.compact();
+            history.push_back(w);
+            expected.push_back(w);
+        }
+    }
+
+    /**
+     * @param history 履歴
+     * @return 履歴の書き込みを古い順に並べた配列
+     */
+    std::vector<write_history::write> collect(const write_history &history)
+    {
+        std::vector<write_history::write> writes;
+        history.for_each([&writes](const write_history::write &w) { writes.push_back(w); });
+        return writes;
+    }
+
+    /**
+     * @param history 履歴
+     * @return 履歴が持つスナップショットを新しい順に並べた配列
+     */
+    std::vector<const write_history::snapshot *> snapshots_of(const write_history &history)
+    {
+        std::vector<const write_history::snapshot *> snapshots;
+        for (auto s = history.get_snapshot().get(); s; s = s->previous.get()) {
+            snapshots.push_back(s);
+        }
+        return snapshots;
+    }
+
+    /**
+     * @brief 分岐した二つの系列が、分岐より前に平坦化したスナップショットを共有することを確かめる
+     */
+    void check_sharing()
+    {
+        write_history parent;
+        std::vector<write_history::write> parent_writes;
+        extend(parent, parent_writes, 0, 3 * write_history::max_links + 5);
+        parent.compact();
+        const auto shared = snapshots_of(parent);
+        expect(!shared.empty(), "parent has no snapshot");
+
+        auto a = parent, b = parent;
+        auto a_writes = parent_writes, b_writes = parent_writes;
+        extend(a, a_writes, 1000, 4 * write_history::max_links);
+        extend(b, b_writes, 2000, 4 * write_history::max_links + 7);
+
+        expect(collect(parent) == parent_writes, "parent history changed by its descendants");
+        expect(collect(a) == a_writes && a.size() == a_writes.size(), "first lineage has wrong writes");
+        expect(collect(b) == b_writes && b.size() == b_writes.size(), "second lineage has wrong writes");
+        expect(a.links() <= write_history::max_links && b.links() <= write_history::max_links, "link chain not bounded");
+
+        // 新しい側から辿り、分岐前のスナップショットに同じ順で行き着く
+        const auto a_snapshots = snapshots_of(a), b_snapshots = snapshots_of(b);
+        expect(a_snapshots.size() > shared.size() && b_snapshots.size() > shared.size(), "lineages did not compact");
+        expect(std::equal(std::rbegin(shared), std::rend(shared), std::rbegin(a_snapshots)), "first lineage copies the shared prefix");
+        expect(std::equal(std::rbegin(shared), std::rend(shared), std::rbegin(b_snapshots)), "second lineage copies the shared prefix");
+        for (const auto s : a_snapshots) {
+            expect(s->count <= write_history::max_links, "snapshot holds more than max_links writes");
+        }
+    }
+}
+
+int main()
+{
+    check_sharing();
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "write_history: OK" << std::endl;
+}
@@ -9,37 +9,176 @@
 #include <span>
 #include <functional>
 #include <algorithm>
+#include <numeric>
 #include <random>
 #include <stdexcept>
+#include <thread>
+#include <exception>
+#include <iterator>
+#include <concepts>
+#include <type_traits>
+#include <unordered_set>
+#include <limits>
+#include <bit>
+#include <cstdint>
+#include <chrono>
+#include <utility>
+
+/**
+ * @brief 子孫ノードを生成する関数の要件
+ * @detail 渡されたノードが条件を満たしているならば true を返却する。
+ * @detail そうでないならば子ノードを生成し、false を返却する。
+ * @detail 第一引数は条件を満たしているか検査する親ノード、第二引数は子ノードを追加する std::back_insert_iterator である。
+ * @tparam F 関数の型
+ * @tparam Node ノードの型
+ */
+template <class F, class Node>
+concept beam_generation_function =
+    std::invocable<const F &, const Node &, std::back_insert_iterator<std::vector<Node>>> &&
+    std::convertible_to<std::invoke_result_t<const F &, const Node &, std::back_insert_iterator<std::vector<Node>>>, bool>;
+
+/**
+ * @brief スコア関数の要件
+ * @detail 渡されたノードのスコアを返却する。
+ * @tparam F 関数の型
+ * @tparam Node ノードの型
+ */
+template <class F, class Node>
+concept beam_scoring_function =
+    std::regular_invocable<const F &, const Node &> &&
+    std::convertible_to<std::invoke_result_t<const F &, const Node &>, int>;
+
+/**
+ * @brief ハッシュ関数を与えない場合の型。重複するノードの除去を行わない。
+ */
+struct beam_no_hash {};
+
+/**
+ * @brief ハッシュ関数の要件
+ * @detail 渡されたノードのハッシュ値を返却する。ハッシュ値が等しいノードは同じ状態を表すとみなす。
+ * @tparam F 関数の型。beam_no_hash でもよい。
+ * @tparam Node ノードの型
+ */
+template <class F, class Node>
+concept beam_hash_function =
+    std::same_as<F, beam_no_hash> || (
+        std::regular_invocable<const F &, const Node &> &&
+        std::convertible_to<std::invoke_result_t<const F &, const Node &>, std::uint64_t>
+    );
+
+/**
+ * @brief 一世代分の探索の統計
+ * @note 時間の単位は秒。expansion_seconds と scoring_seconds はスレッドごとの時間の合計であり、
+ * @note 複数のスレッドで探索した場合は wall_seconds を超えることがある。
+ */
+struct beam_generation_statistics {
+    //! 展開した世代の世代カウント
+    std::size_t generation = 0;
+
+    //! 展開したノードの数
+    std::size_t expanded = 0;
+
+    //! 条件を満たしたノードの数
+    std::size_t found = 0;
+
+    //! 生成された子ノードの数
+    std::size_t children = 0;
+
+    //! 重複を除去した後の子ノードの数
+    std::size_t unique_children = 0;
+
+    //! 次の世代に選ばれたノードの数
+    std::size_t selected = 0;
+
+    //! 子孫ノード生成関数にかかった時間
+    double expansion_seconds = 0;
+
+    //! スコア関数とハッシュ関数にかかった時間
+    double scoring_seconds = 0;
+
+    //! スレッドごとの結果の連結にかかった時間
+    double merge_seconds = 0;
+
+    //! 重複の除去にかかった時間
+    double deduplication_seconds = 0;
+
+    //! 選択と並べ替えにかかった時間。同率最下位のノードの乱択を除く。
+    double selection_seconds = 0;
+
+    //! 同率最下位のノードの乱択にかかった時間
+    double shuffle_seconds = 0;
+
+    //! 一世代分の探索全体にかかった時間
+    double wall_seconds = 0;
+};
 
 /**
  * @brief ビーム探索アルゴリズムの実装
  * @tparam Node ノードの型
  * @tparam Generator std::uniform_random_bit_generator のモデル
+ * @tparam GenerationFunction 子孫ノードを生成する関数の型
+ * @tparam ScoringFunction スコア関数の型
+ * @tparam HashFunction ハッシュ関数の型。beam_no_hash 以外を与えると、同じ状態を表す子ノードを選択の前に除去する。
+ * @note GenerationFunction と ScoringFunction を関数オブジェクトそのものの型にすれば、
+ * @note 探索の内側のループで間接呼び出しが発生せず、インライン展開できるようになる。
+ * @note 省略した場合は std::function となる。
  */
-template <class Node, std::uniform_random_bit_generator Generator = std::mt19937>
+template <
+    class Node,
+    std::uniform_random_bit_generator Generator = std::mt19937,
+    beam_generation_function<Node> GenerationFunction = std::function<bool(const Node &parent, std::back_insert_iterator<std::vector<Node>> bi)>,
+    beam_scoring_function<Node> ScoringFunction = std::function<int(const Node &node)>,
+    beam_hash_function<Node> HashFunction = beam_no_hash
+>
 class beam_searcher final {
 public:
     /**
      * @brief 子孫ノードを生成する関数の型
-     * @detail 渡されたノードが条件を満たしているならば true を返却する。
-     * @detail そうでないならば子ノードを生成し、false を返却する。
-     * @param parent 条件を満たしているか検査する親ノード
-     * @param bi 子ノードを追加する std::back_insert_iterator
-     * @return parent が条件を満たしているか
+     * @see beam_generation_function
      */
-    using generation_function_t = std::function<bool(Node parent, std::back_insert_iterator<std::vector<Node>> bi)>;
+    using generation_function_t = GenerationFunction;
 
     /**
      * @brief スコア関数の型
-     * @param node スコアを計測するノード
-     * @return node のスコア
+     * @see beam_scoring_function
      */
-    using scoring_function_t = std::function<int(Node node)>;
+    using scoring_function_t = ScoringFunction;
+
+    /**
+     * @brief ハッシュ関数の型
+     * @see beam_hash_function
+     */
+    using hash_function_t = HashFunction;
+
+    /**
+     * @brief 置換表（重複除去に用いるハッシュ値の表）の有効範囲
+     */
+    enum class TranspositionScope {
+        Generation, ///< 同じ世代の子ノードの間でのみ重複を除去する
+        Search      ///< 以前の世代に生成されたことのある状態も除去する
+    };
+
+    /**
+     * @brief 一世代分の探索の段階
+     */
+    enum class SearchPhase {
+        Expansion,  ///< 子孫ノードの生成と、子ノードのスコア・ハッシュ値の計算
+        Selection   ///< 結果の連結、重複の除去、次の世代の選択
+    };
+
+    /**
+     * @brief 段階の始まりと終わりに呼ばれる関数の型
+     * @detail 第一引数は段階、第二引数は始まりならば true、終わりならば false である。
+     * @note 探索を呼び出したスレッドから呼ばれる。
+     */
+    using phase_hook_t = std::function<void(SearchPhase phase, bool begins)>;
 
 private:
+    //! ハッシュ関数を用いるか否か
+    static inline constexpr bool deduplicates = !std::same_as<HashFunction, beam_no_hash>;
+
     //! ビーム幅
-    const std::size_t beam_width;
+    std::size_t beam_width;
 
     //! 子孫ノード生成関数
     const generation_function_t check_or_generate;
@@ -47,6 +186,18 @@ private:
     //! スコア関数
     const scoring_function_t scoring_function;
 
+    //! 子孫ノードの生成に用いるスレッド数
+    const std::size_t thread_count;
+
+    //! ハッシュ関数
+    const hash_function_t hash_function;
+
+    //! 置換表の有効範囲
+    const TranspositionScope transposition_scope;
+
+    //! これまでの世代に生成された子ノードのハッシュ値。TranspositionScope::Search の場合のみ用いる。
+    std::unordered_set<std::uint64_t> transposition_table;
+
     //! 世代カウント
     std::size_t generation = 1;
 
@@ -56,6 +207,123 @@ private:
     //! 乱数生成器
     Generator engine;
 
+    //! 最後に探索した世代の統計
+    beam_generation_statistics statistics;
+
+    //! 段階の始まりと終わりに呼ばれる関数。空ならば呼ばない。
+    phase_hook_t phase_hook;
+
+    /**
+     * @brief phase_hook が設定されていれば呼ぶ
+     * @param phase 段階
+     * @param begins 始まりならば true、終わりならば false
+     */
+    void notify(const SearchPhase phase, const bool begins)
+    {
+        if (phase_hook) {
+            phase_hook(phase, begins);
+        }
+    }
+
+    //! 時間の計測に用いる時計
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param start 計測を始めた時刻
+     * @return start からの経過時間（秒）
+     */
+    static double seconds_since(const clock::time_point start) noexcept
+    {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    /**
+     * @brief 同じ状態を表すノードを一つずつに減らす
+     * @param nodes 重複を除去するノード
+     * @param scores nodes の各要素のスコア
+     * @param keys nodes の各要素のハッシュ値
+     * @note 同じ状態を表すノードのうちスコアが最も高いもの（同点ならば先に現れたもの）を残す。
+     */
+    void deduplicate(std::vector<Node> &nodes, std::vector<int> &scores, const std::vector<std::uint64_t> &keys)
+    {
+        // 線形探査のハッシュ表で、ハッシュ値ごとに残すノードの添字を求める
+        constexpr auto empty = std::numeric_limits<std::size_t>::max();
+        const auto capacity = std::bit_ceil(nodes.size() * 2 + 1);
+        std::vector<std::size_t> representatives(capacity, empty);
+        std::vector<bool> keeps(nodes.size(), true);
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            if (transposition_scope == TranspositionScope::Search && transposition_table.contains(keys[i])) {
+                keeps[i] = false;
+                continue;
+            }
+            auto slot = keys[i] & (capacity - 1);
+            while (representatives[slot] != empty && keys[representatives[slot]] != keys[i]) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (representatives[slot] == empty) {
+                representatives[slot] = i;
+            } else if (scores[i] > scores[representatives[slot]]) {
+                keeps[representatives[slot]] = false;
+                representatives[slot] = i;
+            } else {
+                keeps[i] = false;
+            }
+        }
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            if (keeps[i]) {
+                if (transposition_scope == TranspositionScope::Search) {
+                    transposition_table.insert(keys[i]);
+                }
+                nodes[kept] = std::move(nodes[i]);
+                scores[kept] = scores[i];
+                ++kept;
+            }
+        }
+        nodes.resize(kept);
+        scores.resize(kept);
+    }
+
+    /**
+     * @brief スコアの高い順に高々ビーム幅個のノードを選び、スコアの降順に並べる
+     * @param nodes 選択対象のノード。選ばれたノードだけが残る。
+     * @param scores nodes の各要素のスコア
+     * @note ビーム幅に入れるノードのうち同率最下位のものは乱択する。
+     * @note 全体のソートは行わず、境界のスコアを std::ranges::nth_element で求める。
+     */
+    void select(std::vector<Node> &nodes, const std::vector<int> &scores)
+    {
+        std::vector<std::size_t> indices;
+        if (nodes.size() > beam_width) {
+            auto sorted_scores = scores;
+            std::ranges::nth_element(sorted_scores, std::next(std::begin(sorted_scores), beam_width - 1), std::ranges::greater());
+            const auto threshold = sorted_scores[beam_width - 1];
+            std::vector<std::size_t> ties;
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                if (scores[i] > threshold) {
+                    indices.push_back(i);
+                } else if (scores[i] == threshold) {
+                    ties.push_back(i);
+                }
+            }
+            const auto shuffle_start = clock::now();
+            std::ranges::shuffle(ties, engine);
+            statistics.shuffle_seconds = seconds_since(shuffle_start);
+            ties.resize(beam_width - indices.size());
+            indices.insert(std::end(indices), std::begin(ties), std::end(ties));
+        } else {
+            indices.resize(nodes.size());
+            std::iota(std::begin(indices), std::end(indices), std::size_t{0});
+        }
+        std::ranges::stable_sort(indices, std::ranges::greater(), [&scores](const std::size_t i) { return scores[i]; });
+        std::vector<Node> selected;
+        selected.reserve(indices.size());
+        for (const auto i : indices) {
+            selected.push_back(std::move(nodes[i]));
+        }
+        nodes = std::move(selected);
+    }
+
 public:
     /**
      * @param beam_width ビーム幅
@@ -63,24 +331,37 @@ public:
      * @param scoring_function スコア関数
      * @param starting_point 根ノード
      * @param seed 乱数のシード
-     * @throws std::runtime_error ビーム幅がゼロ
+     * @param thread_count 子孫ノードの生成に用いるスレッド数
+     * @param hash_function ハッシュ関数
+     * @param transposition_scope 置換表の有効範囲。hash_function を与えない場合は意味を持たない。
+     * @throws std::runtime_error ビーム幅もしくはスレッド数がゼロ
+     * @note thread_count が 2 以上の場合、check_or_generate は複数のスレッドから同時に呼ばれる。
      */
     beam_searcher(
         const std::size_t beam_width,
-        const generation_function_t check_or_generate,
-        const scoring_function_t scoring_function,
-        const Node starting_point,
-        const Generator::result_type seed = std::random_device{}()
+        const generation_function_t &check_or_generate,
+        const scoring_function_t &scoring_function,
+        const Node &starting_point,
+        const Generator::result_type seed = std::random_device{}(),
+        const std::size_t thread_count = 1,
+        const hash_function_t &hash_function = hash_function_t(),
+        const TranspositionScope transposition_scope = TranspositionScope::Generation
     )
         : beam_width(beam_width),
           check_or_generate(check_or_generate),
           scoring_function(scoring_function),
+          thread_count(thread_count),
+          hash_function(hash_function),
+          transposition_scope(transposition_scope),
           current_generation({starting_point}),
           engine(seed)
     {
         if (beam_width == 0) {
             throw std::runtime_error("beam_width must not be 0.");
         }
+        if (thread_count == 0) {
+            throw std::runtime_error("thread_count must not be 0.");
+        }
     }
 
     /**
@@ -93,12 +374,77 @@ public:
 
     /**
      * @return 現在の世代の読み取り専用 span
+     * @note 選択で作られた世代はスコアの降順に並んでいるので、先頭が最良のノードである。
      */
     std::span<const Node> get_current_generation() const noexcept
     {
         return current_generation;
     }
 
+    /**
+     * @return ビーム幅
+     */
+    std::size_t get_beam_width() const noexcept
+    {
+        return beam_width;
+    }
+
+    /**
+     * @brief ビーム幅を変える
+     * @param width 新しいビーム幅
+     * @throws std::runtime_error width がゼロ
+     * @note 次に search_current_generation() を呼んだときの選択から用いる。メモリ使用量に合わせて調整するために用いる。
+     */
+    void set_beam_width(const std::size_t width)
+    {
+        if (width == 0) {
+            throw std::runtime_error("beam_width must not be 0.");
+        }
+        beam_width = width;
+    }
+
+    /**
+     * @return 乱数生成器
+     * @note チェックポイントに保存し、再開したときに同じ乱数列を続けるために用いる。
+     */
+    const Generator &get_engine() const noexcept
+    {
+        return engine;
+    }
+
+    /**
+     * @brief 保存しておいた世代から探索を再開する
+     * @param generation 世代カウント
+     * @param nodes 現在の世代とするノード
+     * @param engine 乱数生成器
+     * @note TranspositionScope::Search の置換表は空に戻る。
+     */
+    void resume(const std::size_t generation, std::vector<Node> nodes, const Generator &engine)
+    {
+        this->generation = generation;
+        current_generation = std::move(nodes);
+        this->engine = engine;
+        transposition_table.clear();
+    }
+
+    /**
+     * @brief 段階の始まりと終わりに呼ばれる関数を設定する
+     * @param hook 呼ばれる関数。空の std::function を渡すと呼ばれなくなる。
+     * @note ハードウェアカウンタ等で段階ごとに計測するために用いる。
+     */
+    void set_phase_hook(phase_hook_t hook)
+    {
+        phase_hook = std::move(hook);
+    }
+
+    /**
+     * @return 最後に search_current_generation() を呼んだときの統計
+     */
+    const beam_generation_statistics &get_statistics() const noexcept
+    {
+        return statistics;
+    }
+
     /**
      * @brief 現在の世代に条件を満たすものが存在するか検査しつつ、次の世代を生成する
      * @tparam OutputIterator 出力イテレータの型
@@ -106,32 +452,109 @@ public:
      * @return この関数を呼び出した時点での世代に条件を満たすものが存在したか否か。
      * @return 言い換えれば、oi に一つでもノードが出力されたか否か。
      * @note 子ノードが偏るのを防ぐため、ビーム幅に入れるノードのうち同率最下位のものは乱択する。
+     * @note 子孫ノードの生成は現在の世代を連続した区間に分けて並列に行い、結果を区間の順に連結する。
+     * @note そのため、同じシードであればスレッド数によらず同じ結果となる。
+     * @note ハッシュ関数を与えた場合、同じ状態を表す子ノードは選択の前に一つに減らす。
+     * @note 各段階にかかった時間やノードの数は get_statistics() で取り出せる。
+     * @note 子ノードごとの値のうち連続した配列に持つのはスコアとハッシュ値だけであり、選択と重複の除去はそれらの配列だけを走査する。
      */
     template<class OutputIterator>
     bool search_current_generation(OutputIterator oi)
     {
+        const auto chunk_count = std::min(thread_count, current_generation.size());
+        std::vector<std::vector<Node>> children(chunk_count), found(chunk_count);
+        std::vector<std::vector<int>> scores(chunk_count);
+        std::vector<std::vector<std::uint64_t>> keys(chunk_count);
+        std::vector<std::exception_ptr> errors(chunk_count);
+        std::vector<double> expansion_seconds(chunk_count), scoring_seconds(chunk_count);
+        notify(SearchPhase::Expansion, true);
+        const auto start = clock::now();
+        statistics = beam_generation_statistics();
+        statistics.generation = generation;
+        statistics.expanded = current_generation.size();
+        const auto expand = [&](const std::size_t i) {
+            try {
+                const auto expansion_start = clock::now();
+                const auto first = std::next(std::begin(current_generation), current_generation.size() * i / chunk_count);
+                const auto last = std::next(std::begin(current_generation), current_generation.size() * (i + 1) / chunk_count);
+                for (auto itr = first; itr != last; ++itr) {
+                    if (check_or_generate(*itr, std::back_inserter(children[i]))) {
+                        found[i].push_back(*itr);
+                    }
+                }
+                expansion_seconds[i] = seconds_since(expansion_start);
+                // スコア関数は子ノード一つにつき一度だけ呼ぶ
+                const auto scoring_start = clock::now();
+                scores[i].reserve(children[i].size());
+                for (const auto &child : children[i]) {
+                    scores[i].push_back(scoring_function(child));
+                }
+                if constexpr (deduplicates) {
+                    keys[i].reserve(children[i].size());
+                    for (const auto &child : children[i]) {
+                        keys[i].push_back(hash_function(child));
+                    }
+                }
+                scoring_seconds[i] = seconds_since(scoring_start);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        };
+        {
+            std::vector<std::jthread> workers;
+            for (std::size_t i = 1; i < chunk_count; ++i) {
+                workers.emplace_back(expand, i);
+            }
+            if (chunk_count > 0) {
+                expand(0);
+            }
+        }
+        notify(SearchPhase::Expansion, false);
+        for (const auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        notify(SearchPhase::Selection, true);
+        statistics.expansion_seconds = std::reduce(std::begin(expansion_seconds), std::end(expansion_seconds));
+        statistics.scoring_seconds = std::reduce(std::begin(scoring_seconds), std::end(scoring_seconds));
+        const auto merge_start = clock::now();
         bool is_found = false;
-        std::vector<Node> next_generation;
-        for (const auto &parent : current_generation) {
-            if (check_or_generate(parent, std::back_inserter(next_generation))) {
-                *oi++ = parent;
+        for (const auto &nodes : found) {
+            for (const auto &node : nodes) {
+                *oi++ = node;
                 is_found = true;
+                ++statistics.found;
             }
         }
-        std::ranges::sort(next_generation, std::ranges::greater(), scoring_function);
-        if (next_generation.size() > beam_width) {
-            std::ranges::shuffle(
-                std::ranges::equal_range(
-                    next_generation,
-                    scoring_function(next_generation[beam_width - 1]),
-                    std::ranges::greater(), scoring_function
-                ),
-                engine
+        std::vector<Node> next_generation;
+        std::vector<int> next_scores;
+        std::vector<std::uint64_t> next_keys;
+        for (std::size_t i = 0; i < chunk_count; ++i) {
+            next_generation.insert(
+                std::end(next_generation),
+                std::make_move_iterator(std::begin(children[i])),
+                std::make_move_iterator(std::end(children[i]))
             );
-            next_generation.resize(beam_width);
+            next_scores.insert(std::end(next_scores), std::begin(scores[i]), std::end(scores[i]));
+            next_keys.insert(std::end(next_keys), std::begin(keys[i]), std::end(keys[i]));
+        }
+        statistics.merge_seconds = seconds_since(merge_start);
+        statistics.children = next_generation.size();
+        if constexpr (deduplicates) {
+            const auto deduplication_start = clock::now();
+            deduplicate(next_generation, next_scores, next_keys);
+            statistics.deduplication_seconds = seconds_since(deduplication_start);
         }
+        statistics.unique_children = next_generation.size();
+        const auto selection_start = clock::now();
+        select(next_generation, next_scores);
+        statistics.selection_seconds = seconds_since(selection_start) - statistics.shuffle_seconds;
+        statistics.selected = next_generation.size();
+        notify(SearchPhase::Selection, false);
         ++generation;
         current_generation = std::move(next_generation);
+        statistics.wall_seconds = seconds_since(start);
         return is_found;
     }
 };
@@ -3,87 +3,342 @@
  * @brief main 関数
  */
 
-#include "beam_searcher.hpp"
-#include "malbolge.hpp"
 #include "malbolge_machine_state.hpp"
+#include "malbolge_search.hpp"
+#include "perf_counters.hpp"
+#include "target_trie.hpp"
+#include "reachability_table.hpp"
+#include "search_checkpoint.hpp"
+#include "memory_budget.hpp"
+#include "slab_arena.hpp"
 #include <iterator>
-#include <string_view>
-#include <memory>
+#include <vector>
 #include <algorithm>
 #include <random>
 #include <iostream>
-#include <cctype>
-
-using beam_searcher_t = beam_searcher<std::shared_ptr<malbolge_machine_state>>;
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <array>
+#include <stdexcept>
+#include <cstdlib>
 
 namespace {
-    /*
-     * 現在の状態から HELLO WORLD という文字列を出力できるか確かめる。
-     * ただし探索時間を縮めるため、大文字・小文字の違いは無視する。
+    /**
+     * @brief 探索中に数えた事象の回数を取り出し、ゼロに戻す
      */
-    const beam_searcher_t::generation_function_t check_or_generate = [](auto parent, auto bi) {
-        // 目標文字列（大文字・小文字の違いは無視する）
-        constexpr std::string_view target = "Hello World";
-        try {
-            while (true) {
-                const auto result = parent->process();
-                const auto output = parent->get_output();
-                if (result == malbolge_machine_state::ExecutionStatus::Aborted) {
-                    // 異常終了したノードは捨てる
-                    break;
-                } else if (result == malbolge_machine_state::ExecutionStatus::Exited) {
-                    // 出力が（大文字・小文字の違いを除いて）一致しているか否か
-                    // ここでは文字数だけ比較すればよい
-                    return output.length() == target.length();
-                } else if (output.length() > target.length()) {
-                    // すでに target を超える文字数が出力されてしまっている
-                    break;
-                } else if (output.length() > 0 && toupper(output.back()) != toupper(target[output.length() - 1])) {
-                    // すでに target と一致しない文字が出力されてしまっている
-                    break;
-                }
-            }
-        } catch (const malbolge_machine_state::memory_uninitialized_exception &mue) {
-            // 未初期化メモリに 8 種類の命令それぞれを代入し、子ノードとする
-            for (const auto instruction : malbolge::instructions) {
-                *bi++ = std::make_shared<malbolge_machine_state>(parent, mue.address_to_be_set, instruction);
-            }
+    struct counter_values {
+        std::size_t aborted, exited, mismatched, branched, pruned, skipped, steps;
+
+        explicit counter_values(malbolge_search::search_counters &counters) noexcept
+            : aborted(counters.aborted.exchange(0, std::memory_order_relaxed)),
+              exited(counters.exited.exchange(0, std::memory_order_relaxed)),
+              mismatched(counters.mismatched.exchange(0, std::memory_order_relaxed)),
+              branched(counters.branched.exchange(0, std::memory_order_relaxed)),
+              pruned(counters.pruned.exchange(0, std::memory_order_relaxed)),
+              skipped(counters.skipped.exchange(0, std::memory_order_relaxed)),
+              steps(counters.steps.exchange(0, std::memory_order_relaxed))
+        {
         }
-        return false;
     };
 
-    /*
-     * なるべく少ない状態遷移で見つけ出すため、
-     * 「出力された文字数 × 10 - 遷移回数」
-     * をスコアとする。
+    /**
+     * @brief 段階ごとのハードウェアカウンタの計測結果
      */
-    const beam_searcher_t::scoring_function_t scoring_function = [](auto node) {
-        return static_cast<int>(node->get_output().length()) * 10 - static_cast<int>(node->depth);
+    struct phase_profile {
+        //! 子孫ノードの生成の段階
+        perf_counters::reading expansion;
+
+        //! 次の世代の選択の段階
+        perf_counters::reading selection;
     };
-};
 
-int main()
+    /**
+     * @brief ハードウェアカウンタの計測結果を JSON のオブジェクトとして書き出す
+     * @param os 出力先
+     * @param reading 計測結果。値を持たないカウンタは null とする。
+     */
+    void write_reading(std::ostream &os, const perf_counters::reading &reading)
+    {
+        os << '{';
+        for (std::size_t i = 0; i < perf_counters::event_count; ++i) {
+            os << (i == 0 ? "\"" : ",\"") << perf_counters::name(static_cast<perf_counters::Event>(i)) << "\":";
+            if (reading[i]) {
+                os << *reading[i];
+            } else {
+                os << "null";
+            }
+        }
+        os << '}';
+    }
+
+    /**
+     * @brief 一世代分の統計を JSON Lines の一行として書き出す
+     * @param os 出力先
+     * @param statistics ビーム探索の統計
+     * @param counters その世代で数えた事象の回数
+     * @param beam_width その世代の選択に用いたビーム幅
+     * @param profile 段階ごとのハードウェアカウンタの計測結果。計測していなければ nullptr
+     */
+    void write_statistics(
+        std::ostream &os,
+        const beam_generation_statistics &statistics,
+        const counter_values &counters,
+        const std::size_t beam_width,
+        const phase_profile *const profile
+    )
+    {
+        const auto resident_bytes = memory_budget::resident_bytes();
+        const auto heap_bytes = memory_budget::heap_bytes();
+        os << "{\"generation\":" << statistics.generation
+           << ",\"expanded\":" << statistics.expanded
+           << ",\"found\":" << statistics.found
+           << ",\"children\":" << statistics.children
+           << ",\"unique_children\":" << statistics.unique_children
+           << ",\"selected\":" << statistics.selected
+           << ",\"beam_width\":" << beam_width
+           << ",\"aborted\":" << counters.aborted
+           << ",\"exited\":" << counters.exited
+           << ",\"mismatched\":" << counters.mismatched
+           << ",\"branched\":" << counters.branched
+           << ",\"pruned\":" << counters.pruned
+           << ",\"skipped\":" << counters.skipped
+           << ",\"vm_steps\":" << counters.steps
+           << ",\"live_states\":" << malbolge_machine_state::live_states()
+           << ",\"arena_bytes\":" << slab_arena::reserved_bytes()
+           << ",\"resident_bytes\":" << (resident_bytes ? std::to_string(*resident_bytes) : "null")
+           << ",\"heap_bytes\":" << (heap_bytes ? std::to_string(*heap_bytes) : "null")
+           << ",\"expansion_seconds\":" << statistics.expansion_seconds
+           << ",\"scoring_seconds\":" << statistics.scoring_seconds
+           << ",\"merge_seconds\":" << statistics.merge_seconds
+           << ",\"deduplication_seconds\":" << statistics.deduplication_seconds
+           << ",\"selection_seconds\":" << statistics.selection_seconds
+           << ",\"shuffle_seconds\":" << statistics.shuffle_seconds
+           << ",\"wall_seconds\":" << statistics.wall_seconds;
+        if (profile) {
+            os << ",\"perf\":{\"expansion\":";
+            write_reading(os, profile->expansion);
+            os << ",\"selection\":";
+            write_reading(os, profile->selection);
+            os << '}';
+        }
+        os << "}\n";
+    }
+}
+
+/*
+ * 引数に --target STRING を与えると、その文字列を目標とする。複数回与えると、全ての目標文字列を一つのビームで同時に探索し、
+ * 見つかった順に出力する。省略した場合の目標文字列は Hello World である。
+ * 引数に --stats FILE を与えると、世代ごとの統計を JSON Lines で FILE に書き出す。
+ * さらに --profile を与えると、子孫ノードの生成と次の世代の選択の段階それぞれについて
+ * ハードウェアカウンタの値も書き出す。カウンタを使えない環境では警告を出して計測せずに探索する。
+ * 引数に --heuristic WEIGHT を与えると、A レジスタから次の目標の文字を出力できるようになるまでの最短手数に
+ * WEIGHT を掛けてスコアから減点する。その手数の表は --heuristic-cache FILE（省略時は reachability.bin）から読み込み、
+ * 読み込めなければ作って保存する。
+ * 引数に --checkpoint FILE を与えると、--checkpoint-interval N（省略時は 10）世代ごとに探索の状態を FILE に保存する。
+ * --resume FILE を与えると、保存しておいた世代から探索を再開する。
+ * 引数に --memory-limit MIB を与えると、使用量がおよそ MIB メビバイトに収まるよう、世代ごとにビーム幅を調整する。
+ */
+int main(int argc, char *argv[])
 {
+    std::vector<std::string> target_strings;
+    std::ofstream statistics_file;
+    bool profiles = false;
+    int heuristic_weight = 0;
+    std::string heuristic_cache = "reachability.bin";
+    std::string checkpoint_path, resume_path;
+    std::size_t checkpoint_interval = 10;
+    std::size_t memory_limit_mib = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view option = argv[i];
+        if (option == "--target" && i + 1 < argc && *argv[i + 1] != '\0') {
+            target_strings.emplace_back(argv[++i]);
+        } else if (option == "--stats" && i + 1 < argc) {
+            statistics_file.open(argv[++i]);
+            if (!statistics_file) {
+                std::cerr << "cannot open " << argv[i] << '\n';
+                return EXIT_FAILURE;
+            }
+        } else if (option == "--profile") {
+            profiles = true;
+        } else if (option == "--heuristic" && i + 1 < argc && (heuristic_weight = std::atoi(argv[i + 1])) > 0) {
+            ++i;
+        } else if (option == "--heuristic-cache" && i + 1 < argc) {
+            heuristic_cache = argv[++i];
+        } else if (option == "--checkpoint" && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+        } else if (option == "--checkpoint-interval" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            checkpoint_interval = std::atoi(argv[++i]);
+        } else if (option == "--resume" && i + 1 < argc) {
+            resume_path = argv[++i];
+        } else if (option == "--memory-limit" && i + 1 < argc && std::atoll(argv[i + 1]) > 0) {
+            memory_limit_mib = std::atoll(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--target STRING]... [--stats FILE [--profile]] [--heuristic WEIGHT [--heuristic-cache FILE]]"
+                      << " [--checkpoint FILE [--checkpoint-interval N]] [--resume FILE] [--memory-limit MIB]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (profiles && !statistics_file.is_open()) {
+        std::cerr << "--profile requires --stats FILE\n";
+        return EXIT_FAILURE;
+    }
+    std::optional<perf_counters> hardware_counters;
+    if (profiles) {
+        hardware_counters.emplace();
+        if (!hardware_counters->is_available()) {
+            std::cerr << "warning: hardware performance counters are unavailable; profiling is disabled\n";
+            hardware_counters.reset();
+        }
+    }
     constexpr std::size_t beam_width = 10000;
-    beam_searcher_t bs(beam_width, check_or_generate, scoring_function, std::make_shared<malbolge_machine_state>());
-    while (!bs.get_current_generation().empty()) {
-        std::cout << "GENERATION #" << bs.get_generation() << std::endl;
-        std::cout << "\tGENERATION SIZE: " << bs.get_current_generation().size() << std::endl;
-        std::cout << "\tBEST RESULT    : " << bs.get_current_generation().front()->get_output() << std::endl;
-        std::cout << "\tBEST SCORE     : " << scoring_function(bs.get_current_generation().front()) << std::endl;
-        if (
-            std::vector<std::shared_ptr<malbolge_machine_state>> found_solutions;
-            bs.search_current_generation(std::back_inserter(found_solutions))
-        ) {
-            std::shared_ptr<malbolge_machine_state> final_result;
-            std::ranges::sample(found_solutions, &final_result, 1, std::mt19937(std::random_device{}()));
-            std::cout << std::endl;
-            std::cout << "\tFINAL RESULT   : " << final_result->get_output() << std::endl;
-            std::cout << "\tFINAL SCORE    : " << scoring_function(final_result) << std::endl;
-            std::cout << "\tCODE           : " << final_result->generate_code() << std::endl;
+    const std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    if (target_strings.empty()) {
+        target_strings.emplace_back("Hello World");
+    }
+    // 目標文字列（大文字・小文字の違いは無視する）
+    std::shared_ptr<target_trie> targets;
+    try {
+        targets = std::make_shared<target_trie>(target_strings);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    malbolge_search::search_counters counters;
+    const malbolge_search::generation_function check_or_generate(targets, &counters);
+    const auto scoring_function = heuristic_weight > 0
+        ? malbolge_search::scoring_function(
+            std::make_shared<const reachability_table>(reachability_table::load_or_build(heuristic_cache)),
+            targets, heuristic_weight
+        )
+        : malbolge_search::scoring_function();
+    malbolge_search::searcher bs(
+        beam_width, check_or_generate, scoring_function, malbolge_machine_state::descriptor(),
+        std::random_device{}(), thread_count, malbolge_search::hash_function()
+    );
+    if (!resume_path.empty()) {
+        try {
+            auto checkpoint = search_checkpoint::load(resume_path);
+            bs.resume(checkpoint.generation, std::move(checkpoint.nodes), checkpoint.engine);
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    // 使用量の上限。ビーム幅は初期値の 1/100 から初期値までの間で調整する。
+    std::optional<memory_budget> budget;
+    if (memory_limit_mib > 0) {
+        budget.emplace(memory_limit_mib << 20, std::max<std::size_t>(1, beam_width / 100), beam_width);
+    }
+    phase_profile profile;
+    if (hardware_counters || budget) {
+        bs.set_phase_hook([&hardware_counters, &profile, &budget](const malbolge_search::searcher::SearchPhase phase, const bool begins) {
+            // 子ノードや重複除去の表は世代の途中にしか存在しないので、段階の境目ごとに使用量を測る
+            if (budget) {
+                budget->observe();
+            }
+            if (!hardware_counters) {
+                return;
+            }
+            if (begins) {
+                hardware_counters->start();
+            } else {
+                (phase == malbolge_search::searcher::SearchPhase::Expansion ? profile.expansion : profile.selection) = hardware_counters->stop();
+            }
+        });
+    }
+    // 一つ前の世代で捨てたノードの数
+    std::size_t pruned_count = 0;
+    // 解を出力済みの目標文字列
+    std::vector<bool> reported(target_strings.size(), false);
+    std::mt19937 sampler(std::random_device{}());
+    // 前回ビームが空になってから、解が見つかって外した目標文字列があるか否か
+    bool retired_since_restart = false;
+    while (true) {
+        if (bs.get_current_generation().empty()) {
+            if (!retired_since_restart) {
+                break;
+            }
+            // 外した目標文字列の枝がビームを占めていた場合、残りの目標文字列のために初期状態から探索し直す
+            std::cout << "RESTART FROM THE INITIAL STATE" << std::endl;
+            bs.resume(bs.get_generation(), {malbolge_machine_state::descriptor()}, bs.get_engine());
+            retired_since_restart = false;
+        }
+        // 選択の際にスコアの降順に並べてあるので、先頭が最良のノードである
+        const auto &best = bs.get_current_generation().front();
+        std::cout << "GENERATION #" << bs.get_generation() << '\n';
+        std::cout << "\tGENERATION SIZE: " << bs.get_current_generation().size() << '\n';
+        std::cout << "\tBEST RESULT    : " << best.get_output() << '\n';
+        std::cout << "\tBEST SCORE     : " << scoring_function(best) << '\n';
+        if (budget) {
+            std::cout << "\tBEAM WIDTH     : " << bs.get_beam_width() << '\n';
+        }
+        std::cout << "\tPRUNED NODES   : " << pruned_count << std::endl;
+        // 世代ごとに新しいスラブを使い、祖先をスラブごと解放できるようにする
+        slab_arena::next_generation();
+        std::vector<malbolge_machine_state::descriptor> found_solutions;
+        const auto is_found = bs.search_current_generation(std::back_inserter(found_solutions));
+        const counter_values values(counters);
+        pruned_count = values.pruned;
+        if (statistics_file.is_open()) {
+            write_statistics(statistics_file, bs.get_statistics(), values, bs.get_beam_width(), hardware_counters ? &profile : nullptr);
+        }
+        if (budget) {
+            bs.set_beam_width(budget->next_beam_width(bs.get_beam_width()));
+        }
+        if (!checkpoint_path.empty() && bs.get_generation() % checkpoint_interval == 0) {
+            try {
+                search_checkpoint::save(checkpoint_path, bs.get_generation(), bs.get_current_generation(), bs.get_engine());
+            } catch (const std::runtime_error &e) {
+                std::cerr << "warning: " << e.what() << '\n';
+            }
+        }
+        if (!is_found) {
+            continue;
+        }
+        // 見つかった状態を実体化して終了するまで実行し直し、一致した目標文字列ごとに分ける
+        std::vector<std::vector<std::shared_ptr<malbolge_machine_state>>> solutions(target_strings.size());
+        for (const auto &solution : found_solutions) {
+            auto state = solution.materialize();
+            while (state->run().status == malbolge_machine_state::ExecutionStatus::OutputProduced) {
+                ;
+            }
+            if (const auto index = *targets->target_at(*targets->find(state->get_output().str())); !reported[index]) {
+                solutions[index].push_back(std::move(state));
+            }
+        }
+        for (std::size_t i = 0; i < solutions.size(); ++i) {
+            if (solutions[i].empty()) {
+                continue;
+            }
+            std::shared_ptr<malbolge_machine_state> final_state;
+            std::ranges::sample(solutions[i], &final_state, 1, sampler);
+            std::cout << '\n';
+            std::cout << "\tTARGET         : " << target_strings[i] << '\n';
+            std::cout << "\tFINAL RESULT   : " << final_state->get_output() << '\n';
+            std::cout << "\tFINAL SCORE    : " << malbolge_search::score(final_state->get_output().length(), final_state->depth) << '\n';
+            std::cout << "\tCODE           : " << final_state->generate_code() << std::endl;
+            // 以降はこの目標文字列にしか続かないノードを捨て、残りの目標文字列にビームを譲る
+            targets->retire(i);
+            reported[i] = true;
+            retired_since_restart = true;
+        }
+        if (!targets->has_live_targets()) {
             return EXIT_SUCCESS;
         }
     }
-    std::cout << "NOT FOUND..." << std::endl;
+    std::cout << "NOT FOUND..." << '\n';
+    for (std::size_t i = 0; i < target_strings.size(); ++i) {
+        if (!reported[i]) {
+            std::cout << "\tTARGET         : " << target_strings[i] << '\n';
+        }
+    }
+    std::cout << std::flush;
     return EXIT_FAILURE;
 }
@@ -4,10 +4,22 @@
  */
 
 #include "malbolge.hpp"
-#include <string_view>
-#include <utility>
+#include <cstring>
 
 namespace malbolge {
+    namespace {
+        //! op_each() で一度に計算するワードの数。使える SIMD レジスタの幅に合わせる。
+#if defined(__AVX512BW__)
+        constexpr std::size_t lane_count = 32;
+#elif defined(__AVX2__)
+        constexpr std::size_t lane_count = 16;
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+        constexpr std::size_t lane_count = 8;
+#else
+        constexpr std::size_t lane_count = 1;
+#endif
+    }
+
     /**
      * @copydoc malbolge::trit_rotate_right(const word)
      */
@@ -21,69 +33,46 @@ namespace malbolge {
      */
     word op(word t1, word t2)
     {
-        constexpr word table[3][3] = {
-            {1, 0, 0},
-            {1, 0, 2},
-            {2, 2, 1}
-        };
-        word pow = 1, result = 0;
-        for (unsigned i = 0; i < 10; ++i) {
-            result += table[std::exchange(t2, t2 / 3) % 3][std::exchange(t1, t1 / 3) % 3] * std::exchange(pow, pow * 3);
-        }
-        return result;
+        return unpack(packed_op(pack(t1), pack(t2)));
     }
 
     /**
-     * @copydoc malbolge::decode_operation(const word, const word, const bool)
+     * @copydoc malbolge::op_each(std::span<const word>, const word, std::span<word>)
      */
-    std::optional<Instruction> decode_operation(const word address, const word data, const bool treats_non_opcode_as_nop)
+    void op_each(const std::span<const word> lhs, const word rhs, const std::span<word> out) noexcept
     {
-        constexpr std::string_view opcode_decode_table =
-            R"(+b(29e*j1VMEKLyC})8&m#~W>qxdRp0wkrUo[D7,XTcA"lI.v%{gJh4G\-=O@5`_3i<?Z';FNQuY]szf$!BS/|t:Pn6^Ha)";
-        if (data < 33 || data > 126) {
-            return std::nullopt;
-        }
-        for (const auto instruction : instructions) {
-            if (opcode_decode_table[(data - 33 + address) % opcode_decode_table.length()] == std::to_underlying(instruction)) {
-                return instruction;
+        std::size_t i = 0;
+        if constexpr (lane_count > 1) {
+            using word_lanes = word __attribute__((vector_size(lane_count * sizeof(word))));
+            // 右辺のトリット y ごとの、左辺のトリット 0, 1, 2 に対する結果
+            constexpr word results[3][3] = {{1, 0, 0}, {1, 0, 2}, {2, 2, 1}};
+            constexpr std::size_t trits = 10;
+            // 二次式の係数に位取りを掛けておく。16 ビットで桁あふれしても、最終的な和は 3^10 未満なので正しい。
+            word base = 0;
+            std::array<word, trits> linear{}, quadratic{};
+            word y = rhs, place = 1;
+            for (std::size_t k = 0; k < trits; ++k, y /= 3, place *= 3) {
+                const auto &f = results[y % 3];
+                base += static_cast<word>(place * f[0]);
+                linear[k] = static_cast<word>(place * (f[1] - f[0]));
+                quadratic[k] = static_cast<word>(place * (f[2] - 2 * f[1] + f[0]));
+            }
+            for (; i + lane_count <= lhs.size(); i += lane_count) {
+                word_lanes x, r = word_lanes{} + base;
+                std::memcpy(&x, lhs.data() + i, sizeof(x));
+                for (std::size_t k = 0; k < trits; ++k) {
+                    // 定数での除算は上位ビットを取り出す乗算に直される
+                    const word_lanes q = x / 3;
+                    const word_lanes t = x - q * 3;
+                    r += linear[k] * t + quadratic[k] * (t >> 1);
+                    x = q;
+                }
+                std::memcpy(out.data() + i, &r, sizeof(r));
             }
         }
-        if (treats_non_opcode_as_nop) {
-            return Instruction::Nop;
-        } else {
-            return std::nullopt;
-        }
-    }
-
-    /**
-     * @copydoc malbolge::encode_instruction(const word, const Instruction)
-     */
-    word encode_instruction(const word address, const Instruction instruction)
-    {
-        word tmp =
-              instruction == Instruction::MovD ? '('
-            : instruction == Instruction::Jmp ? 'b'
-            : instruction == Instruction::RotR ? '\''
-            : instruction == Instruction::Op ? '>'
-            : instruction == Instruction::Out ? 'c'
-            : instruction == Instruction::In ? 'u'
-            : instruction == Instruction::Exit ? 'Q'
-            : /* instruction == Instruction::Nop */ 'D';
-        tmp = (tmp + 94 - address % 94) % 94;
-        return tmp < 33 ? tmp + 94 : tmp;
-    }
-
-    /**
-     * @copydoc malbolge::encrypt_code(const word)
-     */
-    std::optional<word> encrypt_code(const word data)
-    {
-        constexpr std::string_view code_encryption_table =
-            R"(5z]&gqtyfr$(we4{WP)H-Zn,[%\3dL+Q;>U!pJS72FhOA1CB6v^=I_0/8|jsb9m<.TVac`uY*MK'X~xDl}REokN:#?G"i@)";
-        if (33 <= data && data < 127) {
-            return code_encryption_table[data - 33];
-        } else {
-            return std::nullopt;
+        // レーンに満たない残りと SIMD がない環境では、一ワードずつ表を引いて計算する
+        for (; i < lhs.size(); ++i) {
+            out[i] = op(lhs[i], rhs);
         }
     }
 }
@@ -6,6 +6,12 @@
 #ifndef MALBOLGE_HPP
 #define MALBOLGE_HPP
 #include <optional>
+#include <array>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <cstddef>
 #include <cstdint>
 
 namespace malbolge {
@@ -45,6 +51,85 @@ namespace malbolge {
         Instruction::Nop
     };
 
+    /**
+     * @brief 1 トリットを 2 ビットで表した、ワードの二進化三進表現
+     * @detail 下位のトリットから順に 2 ビットずつ詰め、10 トリットを下位 20 ビットに収める。
+     * @detail 各トリットは 0, 1, 2 をそれぞれ 00, 01, 10 で表す。
+     * @note op 演算がビット演算だけで行えるので、多数のワードに対してベクトル化できる。
+     */
+    using packed_word = std::uint32_t;
+
+    //! packed_word の各トリットの下位ビットの位置を表すマスク
+    static inline constexpr packed_word packed_low_bits = 0x55555;
+
+    /**
+     * @brief 5 トリット分の変換表
+     * @detail packed_quintet_table[t] は 0 <= t < 3^5 の二進化三進表現である。
+     */
+    static inline constexpr auto packed_quintet_table = [] {
+        std::array<packed_word, 243> table{};
+        for (packed_word t = 0; t < 243; ++t) {
+            packed_word p = 0;
+            for (packed_word rest = t, shift = 0; rest > 0; rest /= 3, shift += 2) {
+                p |= rest % 3 << shift;
+            }
+            table[t] = p;
+        }
+        return table;
+    }();
+
+    /**
+     * @brief 5 トリット分の逆変換表
+     * @detail unpacked_quintet_table[p] は 10 ビットの二進化三進表現 p が表す値である。
+     * @detail 11 のビット対を含む p は二進化三進表現ではないので 0 が入っている。
+     */
+    static inline constexpr auto unpacked_quintet_table = [] {
+        std::array<word, 1024> table{};
+        for (word t = 0; t < 243; ++t) {
+            table[packed_quintet_table[t]] = t;
+        }
+        return table;
+    }();
+
+    /**
+     * @brief ワードを二進化三進表現に変換する
+     * @param t 変換するワード
+     * @return t の二進化三進表現
+     */
+    constexpr packed_word pack(const word t) noexcept
+    {
+        return packed_quintet_table[t % 243] | packed_quintet_table[t / 243] << 10;
+    }
+
+    /**
+     * @brief 二進化三進表現をワードに変換する
+     * @param p 変換する二進化三進表現
+     * @return p が表すワード
+     */
+    constexpr word unpack(const packed_word p) noexcept
+    {
+        return unpacked_quintet_table[p & 0x3ff] + unpacked_quintet_table[p >> 10 & 0x3ff] * 243;
+    }
+
+    /**
+     * @brief 二進化三進表現のまま op 演算を行う
+     * @param p1 op 演算の左辺の二進化三進表現
+     * @param p2 op 演算の右辺の二進化三進表現
+     * @return op(unpack(p1), unpack(p2)) の二進化三進表現
+     * @note トリットごとの表を、各トリットの上位ビットと下位ビットに関する論理式に直したものである。
+     */
+    constexpr packed_word packed_op(const packed_word p1, const packed_word p2) noexcept
+    {
+        const auto x0 = p1 & packed_low_bits, x1 = p1 >> 1 & packed_low_bits;
+        const auto y0 = p2 & packed_low_bits, y1 = p2 >> 1 & packed_low_bits;
+        const auto x_is_zero = ~(x0 | x1) & packed_low_bits;
+        // 結果が 1 となるのは (y, x) が (0, 0), (1, 0), (2, 2) のとき
+        const auto r0 = (~y1 & x_is_zero) | (y1 & x1);
+        // 結果が 2 となるのは (y, x) が (1, 2), (2, 0), (2, 1) のとき
+        const auto r1 = (y0 & x1) | (y1 & ~x1 & packed_low_bits);
+        return r0 | r1 << 1;
+    }
+
     /**
      * @brief 右に一けた三進巡回シフトする
      */
@@ -52,9 +137,92 @@ namespace malbolge {
 
     /**
      * @brief op 演算（もしくは crazy 演算）
+     * @note 二進化三進表現に変換して packed_op() で計算する。
      */
     word op(word t1, word t2);
 
+    /**
+     * @brief 多数のワードに同じ右辺で op 演算を行う
+     * @param lhs op 演算の左辺のワードの列
+     * @param rhs op 演算の右辺のワード
+     * @param out 結果の書き込み先。out[i] = op(lhs[i], rhs) となる。
+     * @pre lhs.size() == out.size()
+     * @note 右辺を固定すると、各トリットの結果は左辺のトリット x の二次式 c0 + c1 * x + c2 * (x >> 1) で書ける。
+     * @note 表を引かずに 16 ビットの乗算と加算だけで計算できるので、SIMD レジスタの各レーンに一ワードずつ並べて同時に計算する。
+     * @note レーン数はコンパイル時に使える命令セットで決まり（SSE2 で 8、AVX2 で 16、AVX-512BW で 32）、SIMD がなければ op() を一ワードずつ呼ぶ。
+     */
+    void op_each(std::span<const word> lhs, const word rhs, std::span<word> out) noexcept;
+
+    //! 命令のデコードやメモリの暗号化の対象となるワードの最小値
+    static inline constexpr word graphic_min = 33;
+
+    //! 命令のデコードやメモリの暗号化の対象となるワードの種類数（ASCII の空白文字以外の印字可能文字の数）
+    static inline constexpr word graphic_count = 94;
+
+    /**
+     * @brief 命令のデコード表
+     * @detail decode_table[address % 94][data - 33] は address 番地の data をデコードした結果である。
+     * @detail デコード結果が Instruction のどれかに一致する場合はその値、一致しない場合は 0 が入っている。
+     */
+    static inline constexpr auto decode_table = [] {
+        constexpr std::string_view opcode_decode_string =
+            R"(+b(29e*j1VMEKLyC})8&m#~W>qxdRp0wkrUo[D7,XTcA"lI.v%{gJh4G\-=O@5`_3i<?Z';FNQuY]szf$!BS/|t:Pn6^Ha)";
+        std::array<std::array<word, graphic_count>, graphic_count> table{};
+        for (word address = 0; address < graphic_count; ++address) {
+            for (word data = 0; data < graphic_count; ++data) {
+                const auto decoded = opcode_decode_string[(data + address) % graphic_count];
+                for (const auto instruction : instructions) {
+                    if (decoded == std::to_underlying(instruction)) {
+                        table[address][data] = decoded;
+                    }
+                }
+            }
+        }
+        return table;
+    }();
+
+    /**
+     * @brief 命令のエンコード表
+     * @detail encode_table[address % 94][i] は address 番地でデコードすると instructions[i] になるワードである。
+     */
+    static inline constexpr auto encode_table = [] {
+        std::array<std::array<word, std::size(instructions)>, graphic_count> table{};
+        for (word address = 0; address < graphic_count; ++address) {
+            for (std::size_t i = 0; i < std::size(instructions); ++i) {
+                for (word data = 0; data < graphic_count; ++data) {
+                    if (decode_table[address][data] == std::to_underlying(instructions[i])) {
+                        table[address][i] = data + graphic_min;
+                        break;
+                    }
+                }
+            }
+        }
+        return table;
+    }();
+
+    /**
+     * @brief メモリの暗号化表
+     * @detail encryption_table[data - 33] は data を暗号化した結果である。
+     */
+    static inline constexpr auto encryption_table = [] {
+        constexpr std::string_view code_encryption_string =
+            R"(5z]&gqtyfr$(we4{WP)H-Zn,[%\3dL+Q;>U!pJS72FhOA1CB6v^=I_0/8|jsb9m<.TVac`uY*MK'X~xDl}REokN:#?G"i@)";
+        std::array<word, graphic_count> table{};
+        for (word data = 0; data < graphic_count; ++data) {
+            table[data] = code_encryption_string[data];
+        }
+        return table;
+    }();
+
+    /**
+     * @param data ワード
+     * @return data が空白文字以外の ASCII 印字可能文字であるか否か
+     */
+    constexpr bool is_graphic(const word data) noexcept
+    {
+        return graphic_min <= data && data < graphic_min + graphic_count;
+    }
+
     /**
      * @brief メモリから命令をデコードする
      * @param address アドレス
@@ -65,7 +233,19 @@ namespace malbolge {
      * @return 一致しなかった場合、treats_non_opcode_as_nop == true ならば Instruction::Nop。
      * @return treats_non_opcode_as_nop == false ならば std::nullopt。
      */
-    std::optional<Instruction> decode_operation(const word address, const word data, const bool treats_non_opcode_as_nop = true);
+    constexpr std::optional<Instruction> decode_operation(const word address, const word data, const bool treats_non_opcode_as_nop = true)
+    {
+        if (!is_graphic(data)) {
+            return std::nullopt;
+        }
+        if (const auto decoded = decode_table[address % graphic_count][data - graphic_min]) {
+            return static_cast<Instruction>(decoded);
+        } else if (treats_non_opcode_as_nop) {
+            return Instruction::Nop;
+        } else {
+            return std::nullopt;
+        }
+    }
 
     /**
      * @brief デコード後に instruction に戻るワードを求める
@@ -73,7 +253,14 @@ namespace malbolge {
      * @param instruction 命令
      * @return デコード後に instruction に戻るワード
      */
-    word encode_instruction(const word address, const Instruction instruction);
+    constexpr word encode_instruction(const word address, const Instruction instruction)
+    {
+        std::size_t i = 0;
+        while (instructions[i] != instruction) {
+            ++i;
+        }
+        return encode_table[address % graphic_count][i];
+    }
 
     /**
      * @brief メモリを暗号化する
@@ -81,6 +268,13 @@ namespace malbolge {
      * @return data が空白文字以外の ASCII 印字可能文字である場合は暗号化結果。
      * @return そうでない場合は std::nullopt
      */
-    std::optional<word> encrypt_code(const word data);
+    constexpr std::optional<word> encrypt_code(const word data)
+    {
+        if (is_graphic(data)) {
+            return encryption_table[data - graphic_min];
+        } else {
+            return std::nullopt;
+        }
+    }
 }
 #endif
@@ -4,80 +4,193 @@
  */
 
 #include "malbolge_machine_state.hpp"
+#include "slab_arena.hpp"
+#include <map>
+#include <algorithm>
+#include <functional>
 
 /**
  * @copydoc malbolge_machine_state::check_memory(const malbolge::word)
  */
 std::optional<malbolge::word> malbolge_machine_state::check_memory(const malbolge::word address) const
 {
-    return memory_diffs.contains(address) ? memory_diffs.at(address)
-         : parent ? parent->check_memory(address)
-         : std::nullopt;
+    return memory.get(address);
 }
 
 /**
- * @copydoc malbolge_machine_state::access_memory(const malbolge::word)
+ * @copydoc malbolge_machine_state::hash_with(const std::uint64_t)
  */
-malbolge::word malbolge_machine_state::access_memory(const malbolge::word address) const
+std::uint64_t malbolge_machine_state::hash_with(const std::uint64_t memory_digest) const noexcept
 {
-    if (const auto mem = check_memory(address)) {
-        return *mem;
-    } else {
-        throw memory_uninitialized_exception(address);
+    // メモリのハッシュ値と衝突しないよう、レジスタ等はアドレス空間の外のアドレスに置いたものとして混ぜる
+    const bool operates_next = next_process == &malbolge_machine_state::operate;
+    return memory_digest
+        ^ persistent_memory::hash_word(malbolge::word_size + 0, A)
+        ^ persistent_memory::hash_word(malbolge::word_size + 1, C)
+        ^ persistent_memory::hash_word(malbolge::word_size + 2, D)
+        ^ persistent_memory::hash_word(malbolge::word_size + 3, operates_next)
+        ^ deferred_digest()
+        ^ output.hash() * 0x9e3779b97f4a7c15;
+}
+
+/**
+ * @copydoc malbolge_machine_state::fingerprint()
+ */
+std::uint64_t malbolge_machine_state::fingerprint() const noexcept
+{
+    // 最上位ビットを立て、メモリのハッシュ値の計算に使われる値と重ならないようにする
+    std::uint64_t x = std::uint64_t{1} << 63
+        | std::uint64_t{next_process == &malbolge_machine_state::operate} << 48
+        | std::uint64_t{D} << 32
+        | std::uint64_t{C} << 16
+        | A;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return memory.digest() ^ deferred_digest() ^ x ^ (x >> 31);
+}
+
+/**
+ * @copydoc malbolge_machine_state::word_to_write(const malbolge::word, const malbolge::Instruction)
+ */
+malbolge::word malbolge_machine_state::word_to_write(const malbolge::word address, const malbolge::Instruction instruction) const noexcept
+{
+    auto data = malbolge::encode_instruction(address, instruction);
+    if (deferred_encryptions > 0 && address == deferred_address) {
+        // 命令を表すワードは空白文字以外の印字可能文字なので、暗号化は失敗しない
+        for (std::uint32_t i = 0; i < deferred_encryptions; ++i) {
+            data = *malbolge::encrypt_code(data);
+        }
     }
+    return data;
+}
+
+/**
+ * @copydoc malbolge_machine_state::require_memory(const malbolge::word)
+ */
+malbolge_machine_state::execution_event malbolge_machine_state::require_memory(const malbolge::word address)
+{
+    memory.commit();
+    history.compact();
+    branch_hash = hash();
+    return {ExecutionStatus::MemoryUninitialized, address};
 }
 
 /**
  * @copydoc malbolge_machine_state::operate()
  */
-malbolge_machine_state::ExecutionStatus malbolge_machine_state::operate()
+malbolge_machine_state::execution_event malbolge_machine_state::operate()
 {
-    const auto opcode = malbolge::decode_operation(C, access_memory(C));
+    const auto code = check_memory(C);
+    if (!code) {
+        return require_memory(C);
+    }
+    const auto opcode = malbolge::decode_operation(C, *code);
     if (!opcode) {
-        return ExecutionStatus::Aborted;
+        return {ExecutionStatus::Aborted};
     }
+    auto status = ExecutionStatus::Running;
     switch (*opcode) {
         case malbolge::Instruction::MovD:
-            D = access_memory(D);
+            if (const auto data = check_memory(D)) {
+                D = *data;
+            } else {
+                return require_memory(D);
+            }
             break;
         case malbolge::Instruction::Jmp:
-            C = access_memory(D);
+            if (const auto data = check_memory(D)) {
+                C = *data;
+            } else {
+                return require_memory(D);
+            }
             break;
         case malbolge::Instruction::RotR:
-            A = memory_diffs[D] = malbolge::trit_rotate_right(access_memory(D));
+            if (const auto data = check_memory(D)) {
+                A = malbolge::trit_rotate_right(*data);
+                memory.set(D, A);
+            } else {
+                return require_memory(D);
+            }
             break;
         case malbolge::Instruction::Op:
-            A = memory_diffs[D] = malbolge::op(A, access_memory(D));
+            if (const auto data = check_memory(D)) {
+                A = malbolge::op(A, *data);
+                memory.set(D, A);
+            } else {
+                return require_memory(D);
+            }
             break;
         case malbolge::Instruction::Out:
-            output += static_cast<unsigned char>(A);
+            output += static_cast<char>(static_cast<unsigned char>(A));
+            status = ExecutionStatus::OutputProduced;
             break;
         case malbolge::Instruction::In:
-            return ExecutionStatus::Aborted;
+            return {ExecutionStatus::Aborted};
         case malbolge::Instruction::Exit:
-            return ExecutionStatus::Exited;
+            return {ExecutionStatus::Exited};
         case malbolge::Instruction::Nop:
             ;
             break;
     }
     next_process = &malbolge_machine_state::increment;
-    return ExecutionStatus::Running;
+    return {status};
 }
 
 /**
  * @copydoc malbolge_machine_state::increment()
  */
-malbolge_machine_state::ExecutionStatus malbolge_machine_state::increment()
+malbolge_machine_state::execution_event malbolge_machine_state::increment()
 {
-    const auto encrypted = malbolge::encrypt_code(access_memory(C));
-    if (!encrypted) {
-        return ExecutionStatus::Aborted;
+    if (const auto code = check_memory(C)) {
+        const auto encrypted = malbolge::encrypt_code(*code);
+        if (!encrypted) {
+            return {ExecutionStatus::Aborted};
+        }
+        memory.set(C, *encrypted);
+    } else if (deferred_encryptions == 0 || C == deferred_address) {
+        deferred_address = C;
+        ++deferred_encryptions;
+    } else {
+        return require_memory(C);
     }
-    memory_diffs[C] = *encrypted;
     C = (C + 1) % malbolge::word_size;
     D = (D + 1) % malbolge::word_size;
     next_process = &malbolge_machine_state::operate;
-    return ExecutionStatus::Running;
+    return {ExecutionStatus::Running};
+}
+
+/**
+ * @copydoc malbolge_machine_state::run(const std::size_t, const bool)
+ */
+malbolge_machine_state::execution_event malbolge_machine_state::run(const std::size_t step_budget, const bool detects_cycles)
+{
+    // Brent のアルゴリズム：2 のべき乗ステップごとに指紋を保存し、それと一致したら循環とみなす
+    auto saved_fingerprint = detects_cycles ? fingerprint() : 0;
+    std::size_t power = 1, length = 0;
+    while (true) {
+        if (steps >= step_budget) {
+            return {ExecutionStatus::StepBudgetExceeded};
+        }
+        const auto event = process();
+        if (event.status == ExecutionStatus::MemoryUninitialized) {
+            return event;
+        }
+        ++steps;
+        if (event.status != ExecutionStatus::Running) {
+            return event;
+        }
+        if (detects_cycles) {
+            const auto current_fingerprint = fingerprint();
+            if (current_fingerprint == saved_fingerprint) {
+                return {ExecutionStatus::CycleDetected};
+            }
+            if (++length == power) {
+                saved_fingerprint = current_fingerprint;
+                power *= 2;
+                length = 0;
+            }
+        }
+    }
 }
 
 /**
@@ -86,12 +199,42 @@ malbolge_machine_state::ExecutionStatus malbolge_machine_state::increment()
 std::string malbolge_machine_state::generate_code() const
 {
     std::map<malbolge::word, malbolge::word> original_memory;
-    for (auto sp = shared_from_this(); sp->parent; sp = sp->parent) {
-        original_memory.insert(sp->written_word);
+    history.for_each([&original_memory](const write_history::write &w) { original_memory.insert(w); });
+    auto last = original_memory.rbegin()->first;
+    if (deferred_encryptions > 0) {
+        last = std::max(last, deferred_address);
     }
     std::string code;
-    for (malbolge::word i = 0; i <= original_memory.rbegin()->first; ++i) {
+    for (malbolge::word i = 0; i <= last; ++i) {
         code += original_memory.contains(i) ? original_memory[i] : malbolge::encode_instruction(i, malbolge::Instruction::Nop);
     }
     return code;
 }
+
+/**
+ * @copydoc malbolge_machine_state::descriptor::hash()
+ */
+std::uint64_t malbolge_machine_state::descriptor::hash() const noexcept
+{
+    if (parent) {
+        // address 番地は親状態では未初期化なので、書き込むワードの分を足すだけでよい
+        // 暗号化だけした番地に書き込むならば、子状態はそれを保留しなくなる
+        const auto h = parent->branch_hash ^ persistent_memory::hash_word(address, parent->word_to_write(address, instruction));
+        return parent->deferred_encryptions > 0 && address == parent->deferred_address ? h ^ parent->deferred_digest() : h;
+    } else {
+        return malbolge_machine_state().hash();
+    }
+}
+
+/**
+ * @copydoc malbolge_machine_state::descriptor::materialize()
+ */
+std::shared_ptr<malbolge_machine_state> malbolge_machine_state::descriptor::materialize() const
+{
+    const slab_allocator<malbolge_machine_state> allocator;
+    if (parent) {
+        return std::allocate_shared<malbolge_machine_state>(allocator, *parent, address, instruction);
+    } else {
+        return std::allocate_shared<malbolge_machine_state>(allocator);
+    }
+}
@@ -6,49 +6,58 @@
 #ifndef MALBOLGE_MACHINE_STATE_HPP
 #define MALBOLGE_MACHINE_STATE_HPP
 #include "malbolge.hpp"
+#include "persistent_memory.hpp"
+#include "persistent_output.hpp"
+#include "write_history.hpp"
 #include <string>
-#include <map>
 #include <utility>
 #include <optional>
 #include <memory>
 #include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <atomic>
 
 /**
  * @brief Malbolge 仮想機械の状態
  */
-class malbolge_machine_state final : public std::enable_shared_from_this<malbolge_machine_state> {
+class malbolge_machine_state final {
 public:
     /**
      * @brief プログラムの実行状態
      */
     enum class ExecutionStatus {
-        Running, ///< 実行中
-        Exited,  ///< 正常終了
-        Aborted  ///< 異常終了
+        Running,            ///< 実行中
+        Exited,             ///< 正常終了
+        Aborted,            ///< 異常終了
+        OutputProduced,     ///< 一文字出力した
+        MemoryUninitialized,///< 未初期化のメモリにアクセスしようとした
+        StepBudgetExceeded, ///< 実行できるステップ数の上限に達した
+        CycleDetected       ///< 出力もメモリの要求もないまま同じ状態に戻った
     };
 
     /**
-     * @brief アクセスしようとしたメモリが未初期化であった場合に投げる例外
+     * @brief 実行を中断した理由
      */
-    class memory_uninitialized_exception {
-    public:
-        //! 初期化するべきメモリのアドレス
-        const malbolge::word address_to_be_set;
+    struct execution_event {
+        //! 実行状態
+        ExecutionStatus status;
 
-        /**
-         * @param address_to_be_set 初期化すべきアドレス
-         */
-        inline memory_uninitialized_exception(const malbolge::word address_to_be_set)
-            : address_to_be_set(address_to_be_set)
-        {
-        }
+        //! 初期化するべきメモリのアドレス。status == ExecutionStatus::MemoryUninitialized のときのみ意味を持つ。
+        malbolge::word address_to_be_set = 0;
     };
-private:
-    //! 親状態へのポインタ
-    const std::shared_ptr<malbolge_machine_state> parent = nullptr;
 
-    //! この状態に遷移したときに書き込まれたアドレスとワードの pair。根ノードでは使わない。
-    const std::pair<malbolge::word, malbolge::word> written_word;
+    /**
+     * @brief 次に行う処理
+     */
+    enum class Phase : std::uint8_t {
+        Operate,    ///< 命令のフェッチと実行
+        Increment   ///< メモリの暗号化とレジスタのインクリメント
+    };
+private:
+    //! 初期状態からこの状態に遷移するまでに書き込まれたアドレスとワード。親状態と構造を共有する。
+    write_history history;
 
     //! A レジスタ
     malbolge::word A = 0;
@@ -59,95 +68,344 @@ private:
     //! D レジスタ
     malbolge::word D = 0;
 
-    //! これまでに出力された文字列
-    std::string output;
+    //! 実行せずに暗号化だけした未初期化のメモリのアドレス。deferred_encryptions == 0 ならば意味を持たない。
+    malbolge::word deferred_address = 0;
+
+    //! deferred_address 番地を暗号化した回数。ゼロならば暗号化だけした未初期化のメモリはない。
+    std::uint32_t deferred_encryptions = 0;
+
+    //! これまでに出力された文字列。親状態と構造を共有する。
+    persistent_output output;
+
+    //! メモリ。親状態と構造を共有する。
+    persistent_memory memory;
+
+    //! この状態が作られてから実行したステップ数
+    std::size_t steps = 0;
 
-    //! 親ノードに対するメモリ差分。根ノードでは使わない。
-    std::map<malbolge::word, malbolge::word> memory_diffs;
+    //! 最後に未初期化のメモリにアクセスしようとした時点での状態のハッシュ値
+    std::uint64_t branch_hash = 0;
 
     //! operate() と increment() のうち次に呼ばれるべき方へのポインタ
-    ExecutionStatus(malbolge_machine_state::*next_process)() = &malbolge_machine_state::operate;
+    execution_event(malbolge_machine_state::*next_process)() = &malbolge_machine_state::operate;
+
+    //! 生存している状態の数
+    static inline std::atomic<std::size_t> live_count = 0;
 
     /**
-     * @brief メモリへのアクセスを試みる
-     * @param address アクセスするアドレス
-     * @return address 番地のメモリが初期化されている場合はその値。
-     * @return 初期化されていない場合は std::nullopt
+     * @brief メモリのハッシュ値とレジスタ等を組み合わせ、状態のハッシュ値を求める
+     * @param memory_digest メモリのハッシュ値
+     * @return 状態のハッシュ値
      */
-    std::optional<malbolge::word> check_memory(const malbolge::word address) const;
+    std::uint64_t hash_with(const std::uint64_t memory_digest) const noexcept;
 
     /**
-     * @brief メモリにアクセスする
-     * @param address アクセスするアドレス
-     * @return address 番地のメモリが初期化されている場合はその値。
-     * @return 初期化されていない場合は例外を投げる。
-     * @throws memory_uninitialized_exception address 番地のメモリが初期化されていない
+     * @return 暗号化だけした未初期化のメモリの、ハッシュ値への寄与。なければゼロ
      */
-    malbolge::word access_memory(const malbolge::word address) const;
+    inline std::uint64_t deferred_digest() const noexcept
+    {
+        if (deferred_encryptions == 0) {
+            return 0;
+        }
+        return persistent_memory::hash_word(malbolge::word_size + 4, deferred_address)
+            ^ persistent_memory::hash_word(malbolge::word_size + 5, static_cast<malbolge::word>(deferred_encryptions % malbolge::word_size));
+    }
+
+    /**
+     * @return 出力を除いた状態の指紋。循環の検出に用いる。
+     */
+    std::uint64_t fingerprint() const noexcept;
+
+    /**
+     * @brief 未初期化のメモリにアクセスしようとしたことを報告する
+     * @param address アクセスしようとしたアドレス
+     * @return address を初期化するべきことを表す execution_event
+     * @note 子状態がメモリを共有できるよう、書き込みバッファを反映してから返る。
+     * @note 子状態の記述子がハッシュ値を求められるよう、この時点でのハッシュ値を記録しておく。
+     * @note 子状態が平坦化した結果を共有できるよう、書き込みの履歴もここで平坦化する。
+     */
+    execution_event require_memory(const malbolge::word address);
 
     /**
      * @brief メモリから命令をフェッチし、実行する
-     * @return 命令のフェッチと実行を試みた結果の実行状態
-     * @throws memory_uninitialized_exception 未初期化のメモリにアクセスした
+     * @return 命令のフェッチと実行を試みた結果
      * @warning 標準入力から一文字受け取る In 命令の際には問答無用で異常終了する
      */
-    ExecutionStatus operate();
+    execution_event operate();
 
     /**
      * @brief メモリの暗号化とレジスタのインクリメントを行う
-     * @return メモリの暗号化とレジスタのインクリメントを試みた結果の実行状態
-     * @throws memory_uninitialized_exception 未初期化のメモリにアクセスした
+     * @return メモリの暗号化とレジスタのインクリメントを試みた結果
+     * @note C 番地が未初期化でも、その番地は暗号化されるだけで実行されないので、兄弟の子状態は読まれるまで同じ経路を辿る。
+     * @note そこで暗号化した回数だけを記録して実行を続け、読まれた時点で初めて分岐する。保留できるのは一か所だけである。
+     */
+    execution_event increment();
+
+    /**
+     * @brief operate() と increment() のうち次に呼ばれるべき方を呼ぶ
      */
-    ExecutionStatus increment();
+    inline execution_event process()
+    {
+        return (this->*next_process)();
+    }
 
 public:
     //! 初期状態からの遷移回数
     const std::size_t depth = 0;
 
-    malbolge_machine_state() = default;
+    inline malbolge_machine_state() noexcept
+    {
+        live_count.fetch_add(1, std::memory_order_relaxed);
+    }
 
     /**
      * @brief 親状態に対し、新たに一か所分メモリに追記された子状態を作る
-     * @param ptr_to_parent 親状態へのポインタ
+     * @param parent 親状態
      * @param address 命令を書き込むアドレス
      * @param instruction address 番地に書き込む命令
+     * @note 親状態へのポインタは保持しない。親状態は子状態の記述子が参照しなくなった時点で解放される。
      */
     inline malbolge_machine_state(
-        const std::shared_ptr<malbolge_machine_state> ptr_to_parent,
+        const malbolge_machine_state &parent,
         const malbolge::word address,
         const malbolge::Instruction instruction
     )
-        : parent(ptr_to_parent),
-          written_word(address, malbolge::encode_instruction(address, instruction)),
-          A(parent->A), C(parent->C), D(parent->D),
-          output(parent->output),
-          memory_diffs({written_word}),
-          next_process(parent->next_process),
-          depth(parent->depth + 1)
+        : history(parent.history),
+          A(parent.A), C(parent.C), D(parent.D),
+          deferred_address(parent.deferred_address),
+          deferred_encryptions(address == parent.deferred_address ? 0 : parent.deferred_encryptions),
+          output(parent.output),
+          memory(parent.memory),
+          next_process(parent.next_process),
+          depth(parent.depth + 1)
+    {
+        // 履歴にはソースコードとして書くワードを、メモリには暗号化を済ませたワードを置く
+        history.push_back({address, malbolge::encode_instruction(address, instruction)});
+        memory.set(address, parent.word_to_write(address, instruction));
+        live_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    malbolge_machine_state(const malbolge_machine_state &) = delete;
+
+    inline ~malbolge_machine_state()
+    {
+        live_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return 現在生存している状態の数
+     * @note 子状態の記述子から参照されているだけの状態も含む。
+     */
+    static inline std::size_t live_states() noexcept
     {
+        return live_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief メモリへのアクセスを試みる
+     * @param address アクセスするアドレス
+     * @return address 番地のメモリが初期化されている場合はその値。
+     * @return 初期化されていない場合は std::nullopt
+     */
+    std::optional<malbolge::word> check_memory(const malbolge::word address) const;
+
+    /**
+     * @param address 命令を書き込むアドレス
+     * @param instruction address 番地に書き込む命令
+     * @return この状態の address 番地に instruction を書き込んだ子状態で、address 番地が持つワード
+     * @note 暗号化だけした番地ならば、命令を表すワードをその回数だけ暗号化したものになる。
+     */
+    malbolge::word word_to_write(const malbolge::word address, const malbolge::Instruction instruction) const noexcept;
+
+    /**
+     * @return 初期状態からこの状態に遷移するまでに書き込まれたアドレスとワード
+     */
+    inline const write_history &get_history() const noexcept
+    {
+        return history;
+    }
+
+    /**
+     * @return A レジスタ
+     */
+    inline malbolge::word get_A() const noexcept
+    {
+        return A;
+    }
+
+    /**
+     * @return C レジスタ
+     */
+    inline malbolge::word get_C() const noexcept
+    {
+        return C;
+    }
+
+    /**
+     * @return D レジスタ
+     */
+    inline malbolge::word get_D() const noexcept
+    {
+        return D;
+    }
+
+    /**
+     * @return 次に行う処理
+     */
+    inline Phase get_phase() const noexcept
+    {
+        return next_process == &malbolge_machine_state::operate ? Phase::Operate : Phase::Increment;
     }
 
     /**
      * @return これまでに出力された文字列
+     * @note 長さ、最後の文字、末尾の数文字は persistent_output から直接取り出せる。全体が必要ならば str() を呼ぶ。
      */
-    inline std::string_view get_output() const noexcept
+    inline const persistent_output &get_output() const noexcept
     {
         return output;
     }
 
     /**
-     * @brief operate() と increment() のうち次に呼ばれるべき方を呼ぶ
+     * @brief 実行を中断すべき事象が起こるまでプログラムを実行する
+     * @return 実行を中断した理由。status が ExecutionStatus::Running になることはない。
+     * @note ExecutionStatus::OutputProduced で中断した場合、もう一度呼べば続きから実行する。
+     * @note ExecutionStatus::MemoryUninitialized で中断した場合、その命令は実行されていない。
+     * @note address_to_be_set を初期化した子状態で呼べば、その命令から実行し直す。
+     * @param step_budget この状態が作られてから実行してよいステップ数の上限。
+     * @param step_budget 上限に達した場合は ExecutionStatus::StepBudgetExceeded で中断する。
+     * @param detects_cycles true ならば Brent のアルゴリズムで状態の循環を検出し、
+     * @param detects_cycles 検出した場合は ExecutionStatus::CycleDetected で中断する。
+     * @note 循環の検出は一度の呼び出しの中でのみ行う。出力した時点で呼び出しは終わるので、出力は比較しなくてよい。
      */
-    inline ExecutionStatus process()
+    execution_event run(
+        const std::size_t step_budget = std::numeric_limits<std::size_t>::max(),
+        const bool detects_cycles = false
+    );
+
+    /**
+     * @return この状態が作られてから実行したステップ数
+     */
+    inline std::size_t executed_steps() const noexcept
     {
-        return (this->*next_process)();
+        return steps;
+    }
+
+    /**
+     * @return 状態のハッシュ値
+     * @note レジスタ、次に行う処理、出力、メモリの内容が等しい状態は、遷移の経緯によらず等しいハッシュ値を持つ。
+     */
+    inline std::uint64_t hash() const noexcept
+    {
+        return hash_with(memory.digest());
     }
 
     /**
      * @brief 現在の状態へと遷移できる Malbolge コードを生成する
      * @return 現在の状態へと遷移できる Malbolge コード
      * @note 使用されない命令は全て o（Nop 命令）で埋める
+     * @note 暗号化だけした未初期化のメモリも、暗号化できるよう Nop 命令で埋める
      */
     std::string generate_code() const;
+
+    class descriptor;
+};
+
+/**
+ * @brief まだ実体化していない状態の記述子
+ * @detail 親状態と、そこへ書き込む一か所分の命令だけを保持する。
+ * @detail 実体である malbolge_machine_state は materialize() を呼ぶまで作られないので、
+ * @detail ビーム探索で捨てられる子状態のためにメモリや出力文字列を複製せずに済む。
+ * @note parent == nullptr の記述子は初期状態を表す。
+ */
+class malbolge_machine_state::descriptor final {
+private:
+    //! 親状態へのポインタ。初期状態を表す場合は nullptr
+    std::shared_ptr<const malbolge_machine_state> parent;
+
+    //! 命令を書き込むアドレス
+    malbolge::word address;
+
+    //! address 番地に書き込む命令
+    malbolge::Instruction instruction;
+
+public:
+    /**
+     * @brief 初期状態を表す記述子を作る
+     */
+    inline descriptor() noexcept
+        : parent(nullptr), address(0), instruction(malbolge::Instruction::Nop)
+    {
+    }
+
+    /**
+     * @brief 親状態に対し、新たに一か所分メモリに追記された子状態を表す記述子を作る
+     * @param parent 親状態へのポインタ
+     * @param address 命令を書き込むアドレス
+     * @param instruction address 番地に書き込む命令
+     */
+    inline descriptor(
+        std::shared_ptr<const malbolge_machine_state> parent,
+        const malbolge::word address,
+        const malbolge::Instruction instruction
+    ) noexcept
+        : parent(std::move(parent)), address(address), instruction(instruction)
+    {
+    }
+
+    /**
+     * @return 親状態へのポインタ。初期状態を表す場合は nullptr
+     */
+    inline const std::shared_ptr<const malbolge_machine_state> &get_parent() const noexcept
+    {
+        return parent;
+    }
+
+    /**
+     * @return 命令を書き込むアドレス
+     */
+    inline malbolge::word get_address() const noexcept
+    {
+        return address;
+    }
+
+    /**
+     * @return 書き込む命令
+     */
+    inline malbolge::Instruction get_instruction() const noexcept
+    {
+        return instruction;
+    }
+
+    /**
+     * @return 表している状態の初期状態からの遷移回数
+     */
+    inline std::size_t depth() const noexcept
+    {
+        return parent ? parent->depth + 1 : 0;
+    }
+
+    /**
+     * @return 表している状態がこれまでに出力した文字列
+     */
+    inline const persistent_output &get_output() const noexcept
+    {
+        static const persistent_output empty;
+        return parent ? parent->get_output() : empty;
+    }
+
+    /**
+     * @return 表している状態のハッシュ値
+     * @note 実体化せずに求められる。
+     * @see malbolge_machine_state::hash()
+     */
+    std::uint64_t hash() const noexcept;
+
+    /**
+     * @brief 表している状態を実体化する
+     * @return 新たに作られた状態へのポインタ
+     * @note 状態は slab_arena から確保する。
+     */
+    std::shared_ptr<malbolge_machine_state> materialize() const;
 };
 #endif
@@ -0,0 +1,96 @@
+/**
+ * @file malbolge_search.cpp
+ * @see malbolge_search.hpp
+ */
+
+#include "malbolge_search.hpp"
+#include "malbolge.hpp"
+#include <utility>
+#include <vector>
+#include <string>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <algorithm>
+#include <cctype>
+
+/**
+ * @copydoc malbolge_search::locate(const target_trie &, const persistent_output &)
+ */
+std::optional<target_trie::node_id> malbolge_search::locate(const target_trie &targets, const persistent_output &output)
+{
+    std::optional<target_trie::node_id> position = target_trie::root;
+    output.for_each_segment([&targets, &position](const std::string_view segment) {
+        if (position) {
+            position = targets.find(segment, *position);
+        }
+    });
+    return position;
+}
+
+/**
+ * @copydoc malbolge_search::generation_function::generation_function(std::shared_ptr<const target_trie>, search_counters *const, const std::size_t)
+ */
+malbolge_search::generation_function::generation_function(
+    std::shared_ptr<const target_trie> targets,
+    search_counters *const counters,
+    const std::size_t step_budget
+)
+    : targets(std::move(targets)), step_budget(step_budget), counters(counters)
+{
+}
+
+/**
+ * @copydoc malbolge_search::generation_function::generation_function(std::string, search_counters *const, const std::size_t)
+ */
+malbolge_search::generation_function::generation_function(
+    std::string target,
+    search_counters *const counters,
+    const std::size_t step_budget
+)
+    : generation_function(
+        std::make_shared<const target_trie>(std::vector<std::string>{std::move(target)}),
+        counters, step_budget
+    )
+{
+}
+
+/**
+ * @copydoc malbolge_search::scoring_function::scoring_function(std::shared_ptr<const reachability_table>, std::shared_ptr<const target_trie>, const int)
+ */
+malbolge_search::scoring_function::scoring_function(
+    std::shared_ptr<const reachability_table> table,
+    std::shared_ptr<const target_trie> targets,
+    const int heuristic_weight
+)
+    : table(std::move(table)), targets(std::move(targets)), heuristic_weight(heuristic_weight)
+{
+}
+
+/**
+ * @copydoc malbolge_search::scoring_function::heuristic(const malbolge_machine_state::descriptor &)
+ */
+int malbolge_search::scoring_function::heuristic(const malbolge_machine_state::descriptor &node) const noexcept
+{
+    const auto &parent = node.get_parent();
+    if (!parent) {
+        return 0;
+    }
+    const auto position = locate(*targets, parent->get_output());
+    if (!position) {
+        // どの目標文字列の接頭辞でもないノードは展開の際に捨てられる
+        return 0;
+    }
+    // 子状態の A レジスタは親状態のものと等しい
+    const auto A = parent->get_A();
+    int nearest = reachability_table::unreachable;
+    targets->for_each_next(*position, [this, A, &nearest](const char c) {
+        nearest = std::min({
+            nearest,
+            int{table->distance(c, A)},
+            int{table->distance(static_cast<char>(tolower(static_cast<unsigned char>(c))), A)}
+        });
+    });
+    // 目標文字列の終わりに達しているならば、あとは正常終了するだけでよい
+    return targets->target_at(*position) ? 0 : nearest;
+}
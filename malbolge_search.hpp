@@ -0,0 +1,301 @@
+/**
+ * @file malbolge_search.hpp
+ * @brief Malbolge コードのビーム探索に用いる関数オブジェクト
+ */
+
+#ifndef MALBOLGE_SEARCH_HPP
+#define MALBOLGE_SEARCH_HPP
+#include "beam_searcher.hpp"
+#include "malbolge_machine_state.hpp"
+#include "target_trie.hpp"
+#include "reachability_table.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace malbolge_search {
+    /**
+     * @brief ノードのスコアを求める
+     * @param output_length 出力された文字数
+     * @param depth 初期状態からの遷移回数
+     * @return 「出力された文字数 × 10 - 遷移回数」
+     * @note なるべく少ない状態遷移で見つけ出すため、遷移回数を減点する。
+     */
+    constexpr int score(const std::size_t output_length, const std::size_t depth)
+    {
+        return static_cast<int>(output_length) * 10 - static_cast<int>(depth);
+    }
+
+    /**
+     * @brief 一つのノードを展開する間に実行してよいステップ数の上限の既定値
+     * @note 普通のノードは数十ステップで出力するか未初期化メモリに行き当たるので、十分に大きく取る。
+     */
+    static inline constexpr std::size_t default_step_budget = 1 << 16;
+
+    /**
+     * @brief 探索中に数える事象の回数
+     * @note 複数のスレッドから同時に加算される。
+     */
+    struct search_counters {
+        //! 異常終了したノードの数
+        std::atomic<std::size_t> aborted = 0;
+
+        //! 正常終了したノードの数（目標文字列と一致したか否かを問わない）
+        std::atomic<std::size_t> exited = 0;
+
+        //! いずれの目標文字列とも一致しない文字を出力したノードの数
+        std::atomic<std::size_t> mismatched = 0;
+
+        //! 未初期化のメモリに行き当たり、子ノードを生成したノードの数
+        std::atomic<std::size_t> branched = 0;
+
+        //! 上限に達したか、出力もメモリの要求もないまま循環したために捨てたノードの数
+        std::atomic<std::size_t> pruned = 0;
+
+        //! 最初に実行する命令の結果が親状態から確定し、生成せずに捨てた子ノードの数
+        std::atomic<std::size_t> skipped = 0;
+
+        //! 実行したステップ数の合計
+        std::atomic<std::size_t> steps = 0;
+    };
+
+    /**
+     * @brief 出力された文字列をトライ木で辿る
+     * @param targets 目標文字列の集合
+     * @param output 出力された文字列
+     * @return 辿った先の節点。まだ retire() されていないいずれの目標文字列の接頭辞にもならなければ std::nullopt
+     */
+    std::optional<target_trie::node_id> locate(const target_trie &targets, const persistent_output &output);
+
+    /**
+     * @brief 現在の状態から目標文字列のいずれかを出力できるか確かめ、できなければ子ノードを生成する
+     * @detail 目標文字列の集合はトライ木で表し、出力された文字列がいずれかの接頭辞である間だけ探索を続ける。
+     * @detail 共通の接頭辞を持つ目標文字列は、一つのビームの中で同時に探索される。
+     * @note 探索時間を縮めるため、大文字・小文字の違いは無視する。
+     * @note 兄弟の子ノードは書き込む命令だけが異なり、命令を書き込むアドレスがフェッチしようとした C 番地ならば、
+     * @note 子状態が最初に実行する命令は親状態のレジスタと出力だけから決まる。
+     * @note 異常終了するか、一致しない文字を出力するか、一致しないまま正常終了する子ノードは、実体化する前に兄弟ごとまとめて捨てる。
+     * @note 飛び先が未初期化で、命令を書き込んでも暗号化されるだけで実行されない場合は、兄弟の子ノードは読まれるまで同じ経路を辿るので、
+     * @note 親状態が一度だけ実行を続け、その番地が読まれた時点で分岐する（malbolge_machine_state::increment() を参照）。
+     * @note ノードは平均して 1.2 ステップ程度で分岐するか終了し、各ステップはノードごとの永続的なメモリを引くので、
+     * @note 複数のノードを SIMD のレーンに並べて同時に実行することはしない。レーンに並べるのは malbolge::op_each() のように共通の被演算子を持つ演算だけである。
+     * @see beam_generation_function
+     */
+    class generation_function final {
+    private:
+        //! 目標文字列の集合
+        std::shared_ptr<const target_trie> targets;
+
+        //! 一つのノードを展開する間に実行してよいステップ数の上限
+        std::size_t step_budget;
+
+        //! 事象の回数の加算先。nullptr ならば数えない。
+        search_counters *counters;
+
+        /**
+         * @brief 子状態が最初に実行する命令の結果を親状態から調べ、子ノードを生成するべきか判定する
+         * @param targets 目標文字列の集合
+         * @param position 親状態の出力を辿ったトライ木の節点
+         * @param parent 未初期化のメモリに行き当たった親状態
+         * @param address 命令を書き込むアドレス
+         * @param instruction address 番地に書き込む命令
+         * @return 最初の命令で異常終了するか、一致しない文字を出力するか、一致しないまま正常終了するならば false
+         * @note 書き込んだワードがデータとして読まれる場合は、子状態の実行は親状態のレジスタだけでは決まらないので true を返す。
+         */
+        static inline bool is_viable(
+            const target_trie &targets,
+            const target_trie::node_id position,
+            const malbolge_machine_state &parent,
+            const malbolge::word address,
+            const malbolge::Instruction instruction
+        )
+        {
+            if (parent.get_phase() != malbolge_machine_state::Phase::Operate || address != parent.get_C()) {
+                return true;
+            }
+            // 暗号化だけした番地ならば、書き込んだ命令と実行する命令は異なる
+            const auto opcode = malbolge::decode_operation(address, parent.word_to_write(address, instruction));
+            if (!opcode) {
+                return false;
+            }
+            switch (*opcode) {
+                case malbolge::Instruction::In:
+                    return false;
+                case malbolge::Instruction::Exit:
+                    return targets.target_at(position).has_value();
+                case malbolge::Instruction::Out:
+                    return targets.next(position, static_cast<char>(static_cast<unsigned char>(parent.get_A()))).has_value();
+                default:
+                    return true;
+            }
+        }
+
+    public:
+        /**
+         * @param targets 目標文字列の集合
+         * @param counters 事象の回数の加算先。nullptr ならば数えない。
+         * @param step_budget 一つのノードを展開する間に実行してよいステップ数の上限
+         */
+        generation_function(
+            std::shared_ptr<const target_trie> targets,
+            search_counters *const counters = nullptr,
+            const std::size_t step_budget = default_step_budget
+        );
+
+        /**
+         * @brief 目標文字列が一つだけの場合
+         * @param target 目標文字列
+         * @param counters 事象の回数の加算先。nullptr ならば数えない。
+         * @param step_budget 一つのノードを展開する間に実行してよいステップ数の上限
+         */
+        generation_function(
+            std::string target,
+            search_counters *const counters = nullptr,
+            const std::size_t step_budget = default_step_budget
+        );
+
+        /**
+         * @param parent 検査するノード
+         * @param bi 子ノードの追加先
+         * @return parent がいずれかの目標文字列を出力して正常終了したか否か
+         */
+        inline bool operator()(
+            const malbolge_machine_state::descriptor &parent,
+            std::back_insert_iterator<std::vector<malbolge_machine_state::descriptor>> bi
+        ) const
+        {
+            // ビームに残った状態だけをここで実体化する
+            const auto state = parent.materialize();
+            // 数えるべき事象と、その結果として返す値
+            const auto count = [this, &state](std::atomic<std::size_t> search_counters::*counter, const bool result) {
+                if (counters) {
+                    (counters->*counter).fetch_add(1, std::memory_order_relaxed);
+                    counters->steps.fetch_add(state->executed_steps(), std::memory_order_relaxed);
+                }
+                return result;
+            };
+            // 親状態が作られた後に目標文字列が retire() され、どの目標文字列の接頭辞でもなくなっていることがある
+            const auto initial_position = locate(*targets, state->get_output());
+            if (!initial_position) {
+                return count(&search_counters::mismatched, false);
+            }
+            auto position = *initial_position;
+            while (true) {
+                const auto event = state->run(step_budget, true);
+                switch (event.status) {
+                    case malbolge_machine_state::ExecutionStatus::Aborted:
+                        // 異常終了したノードは捨てる
+                        return count(&search_counters::aborted, false);
+                    case malbolge_machine_state::ExecutionStatus::Exited:
+                        // 出力が（大文字・小文字の違いを除いて）いずれかの目標文字列と一致しているか否か
+                        // ここまでの出力は接頭辞であることを確かめてあるので、目標文字列の終わりに達しているか見ればよい
+                        return count(&search_counters::exited, targets->target_at(position).has_value());
+                    case malbolge_machine_state::ExecutionStatus::OutputProduced:
+                        if (const auto next = targets->next(position, state->get_output().back())) {
+                            position = *next;
+                        } else {
+                            // すでにどの目標文字列とも一致しない文字が出力されてしまっている
+                            return count(&search_counters::mismatched, false);
+                        }
+                        break;
+                    case malbolge_machine_state::ExecutionStatus::MemoryUninitialized:
+                        // 未初期化メモリに 8 種類の命令それぞれを代入し、子ノードとする
+                        for (const auto instruction : malbolge::instructions) {
+                            if (is_viable(*targets, position, *state, event.address_to_be_set, instruction)) {
+                                *bi++ = malbolge_machine_state::descriptor(state, event.address_to_be_set, instruction);
+                            } else if (counters) {
+                                counters->skipped.fetch_add(1, std::memory_order_relaxed);
+                            }
+                        }
+                        return count(&search_counters::branched, false);
+                    case malbolge_machine_state::ExecutionStatus::StepBudgetExceeded:
+                    case malbolge_machine_state::ExecutionStatus::CycleDetected:
+                        // 暴走しているノードは捨てる
+                        return count(&search_counters::pruned, false);
+                    case malbolge_machine_state::ExecutionStatus::Running:
+                        // run() は Running を返さない
+                        break;
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief 子ノードのスコア関数
+     * @note 子ノードは実体化していないので、親状態の出力と遷移回数からスコアを求める。
+     * @note 到達可能性の表を与えた場合は、A レジスタから次の目標の文字を出力できるようになるまでの最短手数に
+     * @note 重みを掛けたものを減点する（ヒューリスティック項）。
+     * @see beam_scoring_function
+     */
+    class scoring_function final {
+    private:
+        //! 到達可能性の表。nullptr ならばヒューリスティック項を用いない。
+        std::shared_ptr<const reachability_table> table;
+
+        //! 目標文字列の集合
+        std::shared_ptr<const target_trie> targets;
+
+        //! ヒューリスティック項の重み
+        int heuristic_weight = 0;
+
+        /**
+         * @param node ノード
+         * @return ヒューリスティック項の重みを掛ける前の値
+         */
+        int heuristic(const malbolge_machine_state::descriptor &node) const noexcept;
+
+    public:
+        /**
+         * @brief ヒューリスティック項を用いない
+         */
+        scoring_function() = default;
+
+        /**
+         * @param table 到達可能性の表
+         * @param targets 目標文字列の集合
+         * @param heuristic_weight ヒューリスティック項の重み
+         */
+        scoring_function(
+            std::shared_ptr<const reachability_table> table,
+            std::shared_ptr<const target_trie> targets,
+            const int heuristic_weight
+        );
+
+        inline int operator()(const malbolge_machine_state::descriptor &node) const noexcept
+        {
+            const auto base = score(node.get_output().length(), node.depth());
+            return table ? base - heuristic_weight * heuristic(node) : base;
+        }
+    };
+
+    /**
+     * @brief 子ノードのハッシュ関数
+     * @note 書き込みの順序が異なっても同じ状態に行き着いたノードは、ビームの中で一つにまとめる。
+     * @see beam_hash_function
+     */
+    struct hash_function {
+        inline std::uint64_t operator()(const malbolge_machine_state::descriptor &node) const noexcept
+        {
+            return node.hash();
+        }
+    };
+
+    /**
+     * @brief Malbolge コードを探索するビーム探索器の型
+     * @note 関数オブジェクトの型をそのまま渡し、探索の内側のループでインライン展開させる。
+     */
+    using searcher = beam_searcher<
+        malbolge_machine_state::descriptor,
+        std::mt19937,
+        generation_function,
+        scoring_function,
+        hash_function
+    >;
+}
+#endif
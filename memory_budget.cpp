@@ -0,0 +1,108 @@
+/**
+ * @file memory_budget.cpp
+ * @see memory_budget.hpp
+ */
+
+#include "memory_budget.hpp"
+#include "slab_arena.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fstream>
+#include <unistd.h>
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define MEMORY_BUDGET_HAS_MALLINFO2 1
+#include <malloc.h>
+#endif
+
+/**
+ * @copydoc memory_budget::memory_budget(const std::size_t, const std::size_t, const std::size_t)
+ */
+memory_budget::memory_budget(const std::size_t limit, const std::size_t min_width, const std::size_t max_width)
+    : limit(limit), min_width(min_width), max_width(max_width)
+{
+    if (limit == 0) {
+        throw std::invalid_argument("memory limit must not be 0.");
+    }
+    if (min_width == 0 || min_width > max_width) {
+        throw std::invalid_argument("beam width range is empty.");
+    }
+    // ヒープを測れなければ usage() は基準を使わない
+    const auto resident = resident_bytes();
+    const auto heap = heap_bytes();
+    baseline = resident && heap && *resident > *heap ? *resident - *heap : 0;
+    previous_usage = usage();
+}
+
+/**
+ * @copydoc memory_budget::resident_bytes()
+ */
+std::optional<std::size_t> memory_budget::resident_bytes() noexcept
+{
+#ifdef __linux__
+    // 二つ目の値が常駐しているページ数
+    std::ifstream statm("/proc/self/statm");
+    std::size_t total_pages = 0, resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+        return resident_pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return std::nullopt;
+}
+
+/**
+ * @copydoc memory_budget::heap_bytes()
+ */
+std::optional<std::size_t> memory_budget::heap_bytes() noexcept
+{
+#ifdef MEMORY_BUDGET_HAS_MALLINFO2
+    // uordblks が brk 及び各アリーナで使用中の大きさ、hblkhd が mmap で確保した大きさ
+    const auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return std::nullopt;
+#endif
+}
+
+/**
+ * @copydoc memory_budget::usage()
+ */
+std::size_t memory_budget::usage() const noexcept
+{
+    if (const auto heap = heap_bytes()) {
+        return baseline + *heap;
+    }
+    return resident_bytes().value_or(slab_arena::reserved_bytes());
+}
+
+/**
+ * @copydoc memory_budget::observe()
+ */
+void memory_budget::observe() noexcept
+{
+    peak_usage = std::max(peak_usage, usage());
+}
+
+/**
+ * @copydoc memory_budget::next_beam_width(const std::size_t)
+ */
+std::size_t memory_budget::next_beam_width(const std::size_t beam_width) noexcept
+{
+    const auto current_usage = std::max(usage(), peak_usage);
+    peak_usage = 0;
+    const auto used = static_cast<double>(current_usage);
+    const auto growth = std::max(used - static_cast<double>(previous_usage), 0.0);
+    previous_usage = current_usage;
+    const auto projected = used + growth * lookahead;
+    const auto ceiling = static_cast<double>(limit);
+    double width = static_cast<double>(beam_width);
+    if (projected > ceiling * shrink_ratio) {
+        width *= ceiling * target_ratio / projected;
+    } else if (projected < ceiling * grow_ratio) {
+        width = std::max(width * growth_factor, width + 1);
+    }
+    return std::clamp(static_cast<std::size_t>(width), min_width, max_width);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file memory_budget.hpp
+ * @brief メモリ使用量の上限に合わせてビーム幅を調整する
+ */
+
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+#include <optional>
+#include <cstddef>
+
+/**
+ * @brief メモリ使用量の上限に合わせてビーム幅を調整する
+ * @detail 生き残ったノードはメモリの木や書き込みの履歴の一部を祖先から共有し続けるので、使用量はビーム幅と深さにおおよそ比例して増える。
+ * @detail 世代ごとに使用量の最大値を測り、直前の世代からの増分が続いた場合の lookahead 世代先の使用量を予測する。
+ * @detail 子ノードや重複除去の表は世代の途中で確保して捨てるので、探索の段階の境目で observe() を呼び、その時点の使用量も最大値に含める。
+ * @detail 予測が上限に近づいたらビーム幅を予測に反比例させて縮め、十分な余裕があれば少しずつ広げる。
+ * @detail ビーム幅を縮めても共有されている領域はしばらく生き残るので、使用量が上限に達してからでは間に合わない。
+ * @note 使用量は、作った時点でのヒープ以外の常駐セットサイズと、現在ヒープで使用中の大きさとの和で見積もる。
+ * @note ヒープの使用量にはスラブだけでなく、重複検出の表や選択の作業領域などスラブ以外から確保した領域も含まれる。
+ * @note 常駐セットサイズそのものは、解放した領域を malloc が抱えたままにするので、ビーム幅を縮めても下がらないことがある。
+ * @note ヒープの使用量を測れない環境では現在の常駐セットサイズで、それも測れなければスラブの大きさで代用する。
+ * @note 上限は目安である。一世代分の増分に比べて上限が小さいと、縮める前に選んだ世代の分だけ上限を超えることがある。
+ */
+class memory_budget final {
+public:
+    //! 何世代先の使用量を予測するか
+    static inline constexpr double lookahead = 3;
+
+    //! 予測した使用量が上限に対してこの割合を超えたらビーム幅を縮める
+    static inline constexpr double shrink_ratio = 0.85;
+
+    //! ビーム幅を縮めるとき、予測した使用量が上限に対してこの割合になることを目指す
+    static inline constexpr double target_ratio = 0.7;
+
+    //! 予測した使用量が上限に対してこの割合を下回ったらビーム幅を広げる
+    static inline constexpr double grow_ratio = 0.5;
+
+    //! 一世代でビーム幅を広げる割合
+    static inline constexpr double growth_factor = 1.25;
+
+private:
+    //! 使用量の上限（バイト）
+    std::size_t limit;
+
+    //! ビーム幅の下限
+    std::size_t min_width;
+
+    //! ビーム幅の上限
+    std::size_t max_width;
+
+    //! 作った時点での、ヒープ以外の使用量の見積もり
+    std::size_t baseline;
+
+    //! 前回 next_beam_width() を呼んだ時点での使用量
+    std::size_t previous_usage;
+
+    //! 前回 next_beam_width() を呼んでから observe() で測った使用量の最大値
+    std::size_t peak_usage = 0;
+
+public:
+    /**
+     * @param limit 使用量の上限（バイト）
+     * @param min_width ビーム幅の下限
+     * @param max_width ビーム幅の上限
+     * @throws std::invalid_argument limit もしくは min_width がゼロであるか、min_width > max_width
+     */
+    memory_budget(const std::size_t limit, const std::size_t min_width, const std::size_t max_width);
+
+    /**
+     * @return プロセスの常駐セットサイズ（バイト）。測れない環境では std::nullopt
+     */
+    static std::optional<std::size_t> resident_bytes() noexcept;
+
+    /**
+     * @return malloc が使用中として確保しているヒープの大きさ（バイト）。測れない環境では std::nullopt
+     * @note mmap で確保した大きな領域と、全てのスレッドのアリーナを含む。
+     */
+    static std::optional<std::size_t> heap_bytes() noexcept;
+
+    /**
+     * @return 現在の使用量の見積もり（バイト）
+     */
+    std::size_t usage() const noexcept;
+
+    /**
+     * @brief 現在の使用量を測り、次に next_beam_width() を呼ぶまでの最大値に含める
+     * @note 世代の途中で一時的に使用量が増える時点で呼ぶ。
+     */
+    void observe() noexcept;
+
+    /**
+     * @param beam_width 現在のビーム幅
+     * @return 予測した使用量に応じた次のビーム幅
+     * @note 世代ごとに一度だけ呼ぶ。使用量には、前回呼んでから observe() で測った最大値を用いる。
+     */
+    std::size_t next_beam_width(const std::size_t beam_width) noexcept;
+};
+#endif
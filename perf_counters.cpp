@@ -0,0 +1,175 @@
+/**
+ * @file perf_counters.cpp
+ * @see perf_counters.hpp
+ */
+
+#include "perf_counters.hpp"
+#include <utility>
+#include <tuple>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace {
+    /**
+     * @brief 事象に対応する perf_event_attr の種類と設定値
+     * @param event 事象
+     * @return type と config の pair
+     */
+    std::pair<std::uint32_t, std::uint64_t> event_config(const perf_counters::Event event) noexcept
+    {
+        constexpr auto cache_read_miss = [](const std::uint64_t cache) {
+            return cache
+                | std::uint64_t{PERF_COUNT_HW_CACHE_OP_READ} << 8
+                | std::uint64_t{PERF_COUNT_HW_CACHE_RESULT_MISS} << 16;
+        };
+        switch (event) {
+            case perf_counters::Event::Cycles:
+                return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+            case perf_counters::Event::Instructions:
+                return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+            case perf_counters::Event::L1DMisses:
+                return {PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_L1D)};
+            case perf_counters::Event::LLCMisses:
+                return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+            case perf_counters::Event::BranchMisses:
+                return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+        }
+        return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+    }
+
+    /**
+     * @brief 一つの事象のカウンタを停止した状態で開く
+     * @param event 事象
+     * @return ファイル記述子。開けなかった場合は -1
+     */
+    int open_counter(const perf_counters::Event event) noexcept
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        std::tie(attr.type, attr.config) = event_config(event);
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        const auto fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        return fd < 0 ? -1 : static_cast<int>(fd);
+    }
+}
+
+perf_counters::perf_counters() noexcept
+{
+    for (std::size_t i = 0; i < event_count; ++i) {
+        fds[i] = open_counter(static_cast<Event>(i));
+    }
+}
+
+perf_counters::~perf_counters()
+{
+    for (const auto fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+/**
+ * @copydoc perf_counters::start()
+ */
+void perf_counters::start() noexcept
+{
+    for (std::size_t i = 0; i < event_count; ++i) {
+        if (fds[i] >= 0) {
+            if (read(fds[i], baselines[i].data(), sizeof(baselines[i])) != sizeof(baselines[i])) {
+                baselines[i].fill(0);
+            }
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/**
+ * @copydoc perf_counters::stop()
+ */
+perf_counters::reading perf_counters::stop() noexcept
+{
+    reading values;
+    for (std::size_t i = 0; i < event_count; ++i) {
+        if (fds[i] < 0) {
+            continue;
+        }
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        // 値、有効だった時間、実際に数えていた時間の順に並ぶ
+        std::array<std::uint64_t, 3> buffer;
+        if (read(fds[i], buffer.data(), sizeof(buffer)) != sizeof(buffer)) {
+            continue;
+        }
+        const auto count = buffer[0] - baselines[i][0];
+        const auto enabled = buffer[1] - baselines[i][1];
+        const auto running = buffer[2] - baselines[i][2];
+        if (running == 0) {
+            values[i] = enabled == 0 ? std::optional<std::uint64_t>(0) : std::nullopt;
+        } else {
+            values[i] = static_cast<std::uint64_t>(static_cast<double>(count) * enabled / running);
+        }
+    }
+    return values;
+}
+#else
+perf_counters::perf_counters() noexcept
+{
+    fds.fill(-1);
+}
+
+perf_counters::~perf_counters()
+{
+}
+
+void perf_counters::start() noexcept
+{
+}
+
+perf_counters::reading perf_counters::stop() noexcept
+{
+    return reading();
+}
+#endif
+
+/**
+ * @copydoc perf_counters::is_available()
+ */
+bool perf_counters::is_available() const noexcept
+{
+    for (const auto fd : fds) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @copydoc perf_counters::name(const Event)
+ */
+std::string_view perf_counters::name(const Event event) noexcept
+{
+    switch (event) {
+        case Event::Cycles:
+            return "cycles";
+        case Event::Instructions:
+            return "instructions";
+        case Event::L1DMisses:
+            return "l1d_misses";
+        case Event::LLCMisses:
+            return "llc_misses";
+        case Event::BranchMisses:
+            return "branch_misses";
+    }
+    return "unknown";
+}
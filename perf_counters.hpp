@@ -0,0 +1,87 @@
+/**
+ * @file perf_counters.hpp
+ * @brief Linux の perf_event_open によるハードウェアカウンタ
+ */
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+#include <array>
+#include <optional>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Linux の perf_event_open によるハードウェアカウンタの組
+ * @detail 呼び出したスレッドと、計測中に作られたスレッドで起きた事象を数える。
+ * @detail スレッドが終了するとその回数は作ったスレッドの側へ加算されるので、
+ * @detail 計測区間の中で std::jthread を作って join すれば、その分も含めて数えられる。
+ * @note カーネルやハードウェアが対応していない、権限がない等の理由で開けなかったカウンタは値を持たない。
+ * @note Linux 以外ではどのカウンタも開けない。
+ */
+class perf_counters final {
+public:
+    /**
+     * @brief 数える事象
+     */
+    enum class Event {
+        Cycles,         ///< CPU サイクル数
+        Instructions,   ///< 実行した命令数
+        L1DMisses,      ///< L1 データキャッシュの読み出しミス
+        LLCMisses,      ///< 最終段キャッシュのミス
+        BranchMisses    ///< 分岐予測ミス
+    };
+
+    //! 事象の種類の数
+    static inline constexpr std::size_t event_count = 5;
+
+    /**
+     * @brief 計測結果
+     * @note 開けなかったカウンタは std::nullopt となる。
+     * @note 多重化により一部の時間しか数えられなかったカウンタは、計測区間全体の値に補正してある。
+     */
+    using reading = std::array<std::optional<std::uint64_t>, event_count>;
+
+private:
+    //! 各事象のファイル記述子。開けなかった場合は -1
+    std::array<int, event_count> fds;
+
+    //! start() の時点での各カウンタの値、有効だった時間、実際に数えていた時間
+    std::array<std::array<std::uint64_t, 3>, event_count> baselines{};
+
+public:
+    /**
+     * @brief 全ての事象のカウンタを停止した状態で開く
+     */
+    perf_counters() noexcept;
+
+    perf_counters(const perf_counters &) = delete;
+
+    perf_counters &operator=(const perf_counters &) = delete;
+
+    ~perf_counters();
+
+    /**
+     * @return 一つでもカウンタを開けたか否か
+     */
+    bool is_available() const noexcept;
+
+    /**
+     * @brief 計測を始める
+     * @note 終了したスレッドから加算された回数はゼロに戻せないので、この時点の値を記録して差を取る。
+     */
+    void start() noexcept;
+
+    /**
+     * @brief 計測を止めて結果を読み出す
+     * @return start() からの各事象の回数
+     */
+    reading stop() noexcept;
+
+    /**
+     * @param event 事象
+     * @return 事象の名前。出力のキーに用いる。
+     */
+    static std::string_view name(const Event event) noexcept;
+};
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file persistent_memory.cpp
+ * @see persistent_memory.hpp
+ */
+
+#include "persistent_memory.hpp"
+#include "slab_arena.hpp"
+#include <atomic>
+
+namespace {
+    /**
+     * @brief node が他から参照されていれば複製する
+     * @param node 書き込もうとしているノードへのポインタ。その親ノードは破壊的に変更してよいものとする。
+     * @param init node が空だった場合に新しいノードを初期化する関数
+     * @return 破壊的に変更してよいノード
+     * @note 親ノードを破壊的に変更してよいならば、node を新たに参照できるのは自分だけなので、参照カウントが 1 ならば共有されていない。
+     */
+    template <class Node, class Init>
+    Node &make_writable(std::shared_ptr<Node> &node, Init init)
+    {
+        if (!node) {
+            node = std::allocate_shared<Node>(slab_allocator<Node>());
+            init(*node);
+        } else if (node.use_count() != 1) {
+            node = std::allocate_shared<Node>(slab_allocator<Node>(), *node);
+        } else {
+            // 他のスレッドが最後の参照を手放す前に行った読み出しより後に書き込む
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *node;
+    }
+}
+
+/**
+ * @copydoc persistent_memory::set(const malbolge::word, const malbolge::word)
+ */
+void persistent_memory::set(const malbolge::word address, const malbolge::word data)
+{
+    contents_digest ^= hash_word(address, data);
+    for (std::size_t i = 0; i < buffered_count; ++i) {
+        if (buffered_addresses[i] == address) {
+            contents_digest ^= hash_word(address, buffered_words[i]);
+            buffered_words[i] = data;
+            return;
+        }
+    }
+    if (const auto old = lookup(address); old != uninitialized) {
+        contents_digest ^= hash_word(address, old);
+    }
+    if (buffered_count == buffer_capacity) {
+        commit();
+    }
+    buffered_addresses[buffered_count] = address;
+    buffered_words[buffered_count] = data;
+    ++buffered_count;
+}
+
+/**
+ * @copydoc persistent_memory::commit()
+ */
+void persistent_memory::commit()
+{
+    for (std::size_t i = 0; i < buffered_count; ++i) {
+        store(buffered_addresses[i], buffered_words[i]);
+    }
+    buffered_count = 0;
+}
+
+/**
+ * @copydoc persistent_memory::store(const malbolge::word, const malbolge::word)
+ */
+void persistent_memory::store(const malbolge::word address, const malbolge::word data)
+{
+    auto &r = make_writable(root, [](root_node &) {});
+    auto &middle = make_writable(r.children[address >> (leaf_bits + branch_bits)], [](middle_node &) {});
+    auto &leaf = make_writable(
+        middle.children[(address >> leaf_bits) & ((1u << branch_bits) - 1)],
+        [](leaf_node &l) { l.words.fill(uninitialized); }
+    );
+    leaf.words[address & ((1u << leaf_bits) - 1)] = data;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file persistent_memory.hpp
+ * @brief 構造共有する永続的な Malbolge メモリ
+ */
+
+#ifndef PERSISTENT_MEMORY_HPP
+#define PERSISTENT_MEMORY_HPP
+#include "malbolge.hpp"
+#include <array>
+#include <memory>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief 構造共有する永続的な Malbolge メモリ
+ * @detail 59049 ワードのアドレス空間を 32 分岐 × 32 分岐 × 64 ワードの三段の基数木で表す。
+ * @detail 読み出しは木の深さ（3 段）に比例する時間で済み、コピーは根へのポインタの共有のみで行われる。
+ * @detail 書き込みはまず小さな書き込みバッファに溜め、溢れたときか commit() のときにまとめて木へ反映する。
+ * @detail 木への反映では、経路上のノードのうち他の persistent_memory と共有しているものだけを複製する（path copying）。
+ * @detail ノードを共有しているか否かは参照カウントで判定するので、コピー元とコピー先のどちらが書き込んでも共有しているノードは複製される。
+ * @note コピー元とコピー先のどちらに書き込んでも、もう一方からは変化が見えない。
+ * @note 内容のハッシュ値を書き込みのたびに差分更新しており、digest() で取り出せる。
+ */
+class persistent_memory final {
+private:
+    //! 葉ノードのアドレスのビット数
+    static inline constexpr unsigned leaf_bits = 6;
+
+    //! 中間ノードのアドレスのビット数
+    static inline constexpr unsigned branch_bits = 5;
+
+    //! 書き込みバッファの容量
+    static inline constexpr std::size_t buffer_capacity = 8;
+
+    //! 未初期化のワードを表す値。Malbolge のワードは 59048 以下なので衝突しない。
+    static inline constexpr malbolge::word uninitialized = std::numeric_limits<malbolge::word>::max();
+
+    /**
+     * @brief 葉ノード
+     */
+    struct leaf_node {
+        //! ワードの配列
+        std::array<malbolge::word, 1u << leaf_bits> words;
+    };
+
+    /**
+     * @brief 中間ノード
+     * @tparam Child 子ノードの型
+     */
+    template <class Child>
+    struct branch_node {
+        //! 子ノードへのポインタの配列
+        std::array<std::shared_ptr<Child>, 1u << branch_bits> children;
+    };
+
+    //! 根の一段下のノードの型
+    using middle_node = branch_node<leaf_node>;
+
+    //! 根ノードの型
+    using root_node = branch_node<middle_node>;
+
+    //! 根ノードへのポインタ
+    std::shared_ptr<root_node> root;
+
+    //! まだ木へ反映していない書き込みのアドレス
+    std::array<malbolge::word, buffer_capacity> buffered_addresses;
+
+    //! まだ木へ反映していない書き込みのワード
+    std::array<malbolge::word, buffer_capacity> buffered_words;
+
+    //! 書き込みバッファに溜まっている書き込みの数
+    std::size_t buffered_count = 0;
+
+    //! 初期化されている全てのワードの hash_word() の排他的論理和
+    std::uint64_t contents_digest = 0;
+
+    /**
+     * @brief 木へ一か所書き込む
+     * @param address 書き込むアドレス
+     * @param data 書き込むワード
+     */
+    void store(const malbolge::word address, const malbolge::word data);
+
+    /**
+     * @brief 木だけからメモリを読み出す
+     * @param address 読み出すアドレス
+     * @return address 番地のワード。初期化されていない場合は uninitialized
+     */
+    inline malbolge::word lookup(const malbolge::word address) const noexcept
+    {
+        if (!root) {
+            return uninitialized;
+        }
+        const auto &middle = root->children[address >> (leaf_bits + branch_bits)];
+        if (!middle) {
+            return uninitialized;
+        }
+        const auto &leaf = middle->children[(address >> leaf_bits) & ((1u << branch_bits) - 1)];
+        if (!leaf) {
+            return uninitialized;
+        }
+        return leaf->words[address & ((1u << leaf_bits) - 1)];
+    }
+
+public:
+    persistent_memory() noexcept = default;
+
+    /**
+     * @brief 構造を共有するコピーを作る
+     * @note 木のノードは両者から参照されるので、以降の書き込みはコピー元とコピー先のどちらでも path copying となる。
+     */
+    persistent_memory(const persistent_memory &other) noexcept = default;
+
+    persistent_memory &operator=(const persistent_memory &other) noexcept = default;
+
+    persistent_memory(persistent_memory &&other) noexcept = default;
+
+    persistent_memory &operator=(persistent_memory &&other) noexcept = default;
+
+    /**
+     * @brief メモリを読み出す
+     * @param address 読み出すアドレス
+     * @return address 番地のメモリが初期化されている場合はその値。
+     * @return 初期化されていない場合は std::nullopt
+     */
+    inline std::optional<malbolge::word> get(const malbolge::word address) const noexcept
+    {
+        for (std::size_t i = 0; i < buffered_count; ++i) {
+            if (buffered_addresses[i] == address) {
+                return buffered_words[i];
+            }
+        }
+        if (const auto data = lookup(address); data != uninitialized) {
+            return data;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief メモリに書き込む
+     * @param address 書き込むアドレス
+     * @param data 書き込むワード
+     */
+    void set(const malbolge::word address, const malbolge::word data);
+
+    /**
+     * @brief 書き込みバッファの内容を木へ反映する
+     * @note コピーする前に呼んでおくと、コピー先がそれぞれ同じ path copying を繰り返さずに済む。
+     */
+    void commit();
+
+    /**
+     * @return 内容のハッシュ値。内容が等しければ書き込みの順序によらず等しい。
+     */
+    inline std::uint64_t digest() const noexcept
+    {
+        return contents_digest;
+    }
+
+    /**
+     * @brief 一つのワードのハッシュ値
+     * @param address アドレス
+     * @param data address 番地のワード
+     * @return digest() に寄与する値
+     */
+    static constexpr std::uint64_t hash_word(const malbolge::word address, const malbolge::word data) noexcept
+    {
+        // splitmix64 の最終段
+        std::uint64_t x = (std::uint64_t{address} << 16 | data) + 0x9e3779b97f4a7c15;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+        return x ^ (x >> 31);
+    }
+};
+#endif
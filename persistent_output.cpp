@@ -0,0 +1,34 @@
+/**
+ * @file persistent_output.cpp
+ * @see persistent_output.hpp
+ */
+
+#include "persistent_output.hpp"
+#include "slab_arena.hpp"
+
+/**
+ * @copydoc persistent_output::push_back(const char)
+ */
+void persistent_output::push_back(const char c)
+{
+    if (tail_size == tail_capacity) {
+        frozen = std::allocate_shared<chunk>(
+            slab_allocator<chunk>(), chunk{frozen, tail_size, tail_chars}
+        );
+        tail_size = 0;
+    }
+    tail_chars[tail_size++] = c;
+    ++total_length;
+    digest = (digest ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+}
+
+/**
+ * @copydoc persistent_output::str()
+ */
+std::string persistent_output::str() const
+{
+    std::string s;
+    s.reserve(total_length);
+    for_each_segment([&s](const std::string_view segment) { s += segment; });
+    return s;
+}
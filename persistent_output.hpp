@@ -0,0 +1,168 @@
+/**
+ * @file persistent_output.hpp
+ * @brief 構造共有する永続的な出力文字列
+ */
+
+#ifndef PERSISTENT_OUTPUT_HPP
+#define PERSISTENT_OUTPUT_HPP
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 構造共有する永続的な出力文字列
+ * @detail 末尾の高々 tail_capacity 文字をオブジェクト自身に持ち、それより前の文字は親から共有する不変のチャンクの連結リストに置く。
+ * @detail 末尾が溢れたときは末尾の文字列を一つのチャンクとして凍結し、リストの先頭に繋ぐ。
+ * @detail コピーはチャンクへのポインタと末尾の文字列の複製のみで行われ、ヒープ領域を確保しない。
+ * @note 長さとハッシュ値は追記のたびに更新して保持している。
+ */
+class persistent_output final {
+public:
+    //! オブジェクト自身に持つ末尾の文字数の上限
+    static inline constexpr std::size_t tail_capacity = 15;
+
+private:
+    /**
+     * @brief 凍結したチャンク
+     */
+    struct chunk {
+        //! 一つ前のチャンク。先頭のチャンクでは nullptr
+        std::shared_ptr<const chunk> previous;
+
+        //! このチャンクの文字数
+        std::size_t size;
+
+        //! このチャンクの文字
+        std::array<char, tail_capacity> chars;
+    };
+
+    //! 凍結したチャンクのうち最後のもの。なければ nullptr
+    std::shared_ptr<const chunk> frozen;
+
+    //! 文字列全体のハッシュ値
+    std::uint64_t digest = 0xcbf29ce484222325;
+
+    //! 文字列全体の長さ
+    std::uint32_t total_length = 0;
+
+    //! 末尾の文字数
+    std::uint8_t tail_size = 0;
+
+    //! 末尾の文字
+    std::array<char, tail_capacity> tail_chars{};
+
+    /**
+     * @brief チャンクを古い順に辿る
+     * @param c 辿り始めるチャンク。nullptr ならば何もしない
+     * @param f 各チャンクの文字列を受け取る関数
+     */
+    template <class F>
+    static void visit_chunks(const chunk *const c, F &f)
+    {
+        if (c) {
+            visit_chunks(c->previous.get(), f);
+            f(std::string_view(c->chars.data(), c->size));
+        }
+    }
+
+public:
+    /**
+     * @brief 一文字追記する
+     * @param c 追記する文字
+     * @note 末尾が溢れる場合は末尾をチャンクとして凍結する。このときだけ領域を確保する。
+     */
+    void push_back(const char c);
+
+    /**
+     * @brief 一文字追記する
+     * @param c 追記する文字
+     * @return *this
+     */
+    inline persistent_output &operator+=(const char c)
+    {
+        push_back(c);
+        return *this;
+    }
+
+    /**
+     * @return 文字列全体の長さ
+     */
+    inline std::size_t length() const noexcept
+    {
+        return total_length;
+    }
+
+    /**
+     * @return 文字列全体の長さ
+     */
+    inline std::size_t size() const noexcept
+    {
+        return total_length;
+    }
+
+    /**
+     * @return 空文字列であるか否か
+     */
+    inline bool empty() const noexcept
+    {
+        return total_length == 0;
+    }
+
+    /**
+     * @return 最後の文字
+     * @pre !empty()
+     * @note 追記した直後は末尾が必ず一文字以上あるので、チャンクを辿らずに済む。
+     */
+    inline char back() const noexcept
+    {
+        return tail_size > 0 ? tail_chars[tail_size - 1] : frozen->chars[frozen->size - 1];
+    }
+
+    /**
+     * @return オブジェクト自身に持つ末尾の文字列。空でなければ文字列全体の最後の 1 〜 tail_capacity 文字
+     */
+    inline std::string_view tail() const noexcept
+    {
+        return std::string_view(tail_chars.data(), tail_size);
+    }
+
+    /**
+     * @return 文字列全体のハッシュ値（FNV-1a）
+     */
+    inline std::uint64_t hash() const noexcept
+    {
+        return digest;
+    }
+
+    /**
+     * @brief 文字列全体を先頭から区切りごとに辿る
+     * @param f 各区切りの文字列を std::string_view で受け取る関数
+     */
+    template <class F>
+    void for_each_segment(F f) const
+    {
+        visit_chunks(frozen.get(), f);
+        if (tail_size > 0) {
+            f(tail());
+        }
+    }
+
+    /**
+     * @return 文字列全体の複製
+     */
+    std::string str() const;
+
+    /**
+     * @brief 文字列全体を出力する
+     */
+    friend inline std::ostream &operator<<(std::ostream &os, const persistent_output &output)
+    {
+        output.for_each_segment([&os](const std::string_view s) { os << s; });
+        return os;
+    }
+};
+#endif
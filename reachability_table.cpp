@@ -0,0 +1,174 @@
+/**
+ * @file reachability_table.cpp
+ * @see reachability_table.hpp
+ */
+
+#include "reachability_table.hpp"
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <system_error>
+
+namespace {
+    //! ファイルの先頭に置く識別子
+    constexpr std::array<char, 4> file_magic = {'M', 'B', 'R', 'T'};
+
+    //! ファイルの形式の版。表の作り方を変えたら増やす。
+    constexpr std::uint32_t file_version = 1;
+
+    /**
+     * @brief ファイルの先頭に置く情報
+     */
+    struct file_header {
+        std::array<char, 4> magic;
+        std::uint32_t version;
+        std::uint32_t word_size;
+        std::uint32_t first_character;
+        std::uint32_t character_count;
+    };
+}
+
+/**
+ * @copydoc reachability_table::build()
+ */
+reachability_table reachability_table::build()
+{
+    // Op による遷移 x -> op(x, m) を逆向きに辿れるよう、遷移先ごとに遷移元を並べる（CSR 形式）
+    // 遷移先は m ごとに全てのワードについてまとめて求める
+    std::vector<malbolge::word> sources(malbolge::word_size), destinations(malbolge::word_size);
+    std::iota(std::begin(sources), std::end(sources), malbolge::word{0});
+    std::vector<std::uint32_t> offsets(malbolge::word_size + 1, 0);
+    for (malbolge::word m = malbolge::graphic_min; m < malbolge::graphic_min + malbolge::graphic_count; ++m) {
+        malbolge::op_each(sources, m, destinations);
+        for (const auto y : destinations) {
+            ++offsets[y + 1];
+        }
+    }
+    for (std::size_t y = 0; y < malbolge::word_size; ++y) {
+        offsets[y + 1] += offsets[y];
+    }
+    std::vector<malbolge::word> predecessors(offsets.back());
+    {
+        auto cursors = offsets;
+        for (malbolge::word m = malbolge::graphic_min; m < malbolge::graphic_min + malbolge::graphic_count; ++m) {
+            malbolge::op_each(sources, m, destinations);
+            for (const auto x : sources) {
+                predecessors[cursors[destinations[x]]++] = x;
+            }
+        }
+    }
+    // RotR ではどのワードからも、印字可能文字を三進巡回シフトしたワードに一手で移れる
+    std::vector<bool> rotated(malbolge::word_size, false);
+    for (malbolge::word m = malbolge::graphic_min; m < malbolge::graphic_min + malbolge::graphic_count; ++m) {
+        rotated[malbolge::trit_rotate_right(m)] = true;
+    }
+    reachability_table table;
+    table.distances.assign(character_count * malbolge::word_size, unreachable);
+    std::vector<malbolge::word> queue(malbolge::word_size);
+    for (std::size_t row = 0; row < character_count; ++row) {
+        const auto distances = std::next(std::begin(table.distances), row * malbolge::word_size);
+        const auto target = static_cast<unsigned char>(first_character + row);
+        std::size_t head = 0, tail = 0;
+        for (std::uint32_t y = target; y < malbolge::word_size; y += 256) {
+            distances[y] = 0;
+            queue[tail++] = static_cast<malbolge::word>(y);
+        }
+        bool rotation_used = false;
+        while (head < tail && tail < malbolge::word_size) {
+            const auto y = queue[head++];
+            const auto d = distances[y];
+            if (!rotation_used && rotated[y]) {
+                // 最初に取り出した RotR の行き先が最も近いので、残りのワードは全てそこから一手
+                rotation_used = true;
+                for (std::uint32_t x = 0; x < malbolge::word_size; ++x) {
+                    if (distances[x] == unreachable) {
+                        distances[x] = static_cast<std::uint8_t>(d + 1);
+                        queue[tail++] = static_cast<malbolge::word>(x);
+                    }
+                }
+                break;
+            }
+            for (auto i = offsets[y]; i < offsets[y + 1]; ++i) {
+                const auto x = predecessors[i];
+                if (distances[x] == unreachable) {
+                    distances[x] = static_cast<std::uint8_t>(std::min<int>(d + 1, unreachable - 1));
+                    queue[tail++] = x;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+/**
+ * @copydoc reachability_table::load(const std::filesystem::path &)
+ */
+std::optional<reachability_table> reachability_table::load(const std::filesystem::path &path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        return std::nullopt;
+    }
+    file_header header;
+    if (!ifs.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        return std::nullopt;
+    }
+    if (
+        header.magic != file_magic || header.version != file_version ||
+        header.word_size != malbolge::word_size ||
+        header.first_character != first_character || header.character_count != character_count
+    ) {
+        return std::nullopt;
+    }
+    reachability_table table;
+    table.distances.resize(character_count * malbolge::word_size);
+    if (!ifs.read(reinterpret_cast<char *>(table.distances.data()), table.distances.size()) || ifs.peek() != std::ifstream::traits_type::eof()) {
+        return std::nullopt;
+    }
+    return table;
+}
+
+/**
+ * @copydoc reachability_table::load_or_build(const std::filesystem::path &)
+ */
+reachability_table reachability_table::load_or_build(const std::filesystem::path &path)
+{
+    if (auto table = load(path)) {
+        return std::move(*table);
+    }
+    auto table = build();
+    try {
+        table.save(path);
+    } catch (const std::runtime_error &) {
+        // 次回も作り直すだけなので無視する
+    }
+    return table;
+}
+
+/**
+ * @copydoc reachability_table::save(const std::filesystem::path &)
+ */
+void reachability_table::save(const std::filesystem::path &path) const
+{
+    // 書きかけのファイルを読まれないよう、一時ファイルに書いてから置き換える
+    auto temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream ofs(temporary, std::ios::binary | std::ios::trunc);
+        const file_header header = {file_magic, file_version, malbolge::word_size, first_character, character_count};
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(distances.data()), distances.size());
+        if (!ofs.flush()) {
+            throw std::runtime_error("cannot write " + temporary.string());
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        throw std::runtime_error("cannot write " + path.string());
+    }
+}
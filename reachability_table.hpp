@@ -0,0 +1,82 @@
+/**
+ * @file reachability_table.hpp
+ * @brief A レジスタから目標の文字を出力できるようになるまでの最短手数の表
+ */
+
+#ifndef REACHABILITY_TABLE_HPP
+#define REACHABILITY_TABLE_HPP
+#include "malbolge.hpp"
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A レジスタから目標の文字を出力できるようになるまでの最短手数の表
+ * @detail Out 命令は A レジスタの下位 8 ビットを出力する。A レジスタを書き換える命令は、
+ * @detail A と D 番地の値の op 演算を行う Op と、D 番地の値を三進巡回シフトした値を代入する RotR の二つである。
+ * @detail D 番地の値を空白文字以外の ASCII 印字可能文字（コードとして書き込まれる値）に限ったとき、
+ * @detail 各ワードから、下位 8 ビットが目標の文字と一致するワードまでに要する Op と RotR の最小回数を全て求めておく。
+ * @note 表は malbolge::op と malbolge::trit_rotate_right から逆向きの幅優先探索で作る。
+ * @note 探索のたびに作り直さずに済むよう、ファイルに保存して次回から読み込めるようにしてある。
+ */
+class reachability_table final {
+public:
+    //! 表に含める最初の文字（空白文字）
+    static inline constexpr unsigned char first_character = ' ';
+
+    //! 表に含める文字の数（ASCII の印字可能文字全て）
+    static inline constexpr std::size_t character_count = 95;
+
+    //! 到達できない場合の手数
+    static inline constexpr std::uint8_t unreachable = 0xff;
+
+private:
+    //! 文字ごとに malbolge::word_size 個並べた手数
+    std::vector<std::uint8_t> distances;
+
+    reachability_table() = default;
+
+public:
+    /**
+     * @brief 表を作る
+     * @return 作った表
+     */
+    static reachability_table build();
+
+    /**
+     * @brief ファイルから表を読み込む
+     * @param path ファイルのパス
+     * @return 読み込んだ表。ファイルがないか、形式や大きさが合わなければ std::nullopt
+     */
+    static std::optional<reachability_table> load(const std::filesystem::path &path);
+
+    /**
+     * @brief ファイルから表を読み込み、読み込めなければ作ってファイルに保存する
+     * @param path ファイルのパス
+     * @return 表
+     * @note 保存に失敗しても、作った表をそのまま返す。
+     */
+    static reachability_table load_or_build(const std::filesystem::path &path);
+
+    /**
+     * @brief 表をファイルに保存する
+     * @param path ファイルのパス
+     * @throws std::runtime_error ファイルに書き込めなかった
+     */
+    void save(const std::filesystem::path &path) const;
+
+    /**
+     * @param c 出力したい文字
+     * @param A A レジスタの値
+     * @return A レジスタの値から c を出力できるようになるまでの Op と RotR の最小回数。
+     * @return c が表にない文字であるか、到達できなければ unreachable
+     */
+    inline std::uint8_t distance(const char c, const malbolge::word A) const noexcept
+    {
+        const auto row = static_cast<unsigned char>(c) - std::size_t{first_character};
+        return row < character_count ? distances[row * malbolge::word_size + A] : unreachable;
+    }
+};
+#endif
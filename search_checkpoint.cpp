@@ -0,0 +1,277 @@
+/**
+ * @file search_checkpoint.cpp
+ * @see search_checkpoint.hpp
+ */
+
+#include "search_checkpoint.hpp"
+#include "malbolge.hpp"
+#include <array>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+    //! ファイルの先頭に置く識別子
+    constexpr std::array<char, 4> file_magic = {'M', 'B', 'C', 'K'};
+
+    //! ファイルの形式の版
+    constexpr std::uint32_t file_version = 1;
+
+    //! 親がない（初期状態である）ことを表す親の番号
+    constexpr std::uint32_t no_parent = std::numeric_limits<std::uint32_t>::max();
+
+    /**
+     * @brief ファイルの先頭に置く情報
+     */
+    struct file_header {
+        std::array<char, 4> magic;
+        std::uint32_t version;
+        std::uint64_t generation;
+        std::uint64_t ancestor_count;
+        std::uint64_t node_count;
+        std::uint64_t engine_state_size;
+    };
+
+    /**
+     * @brief 状態もしくは記述子のレコード
+     * @detail parent が no_parent ならば初期状態を表し、address と instruction は意味を持たない。
+     * @detail そうでなければ、parent 番の祖先の address 番地に instruction を書き込んだ状態を表す。
+     */
+    struct record {
+        std::uint32_t parent;
+        malbolge::word address;
+        std::uint16_t instruction;
+    };
+
+    static_assert(sizeof(file_header) % alignof(record) == 0);
+
+    /**
+     * @brief 読み込み専用で mmap したファイル
+     */
+    class mapped_file final {
+    private:
+        void *address = MAP_FAILED;
+        std::size_t length = 0;
+
+    public:
+        /**
+         * @param path ファイルのパス
+         * @throws std::runtime_error ファイルを開けないか、mmap できない
+         */
+        explicit mapped_file(const std::filesystem::path &path)
+        {
+            const auto fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("cannot open " + path.string());
+            }
+            struct stat st{};
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                length = static_cast<std::size_t>(st.st_size);
+                address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            close(fd);
+            if (address == MAP_FAILED) {
+                throw std::runtime_error("cannot map " + path.string());
+            }
+        }
+
+        mapped_file(const mapped_file &) = delete;
+
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file()
+        {
+            munmap(address, length);
+        }
+
+        /**
+         * @return ファイルの先頭へのポインタ
+         */
+        const char *data() const noexcept
+        {
+            return static_cast<const char *>(address);
+        }
+
+        /**
+         * @return ファイルの大きさ
+         */
+        std::size_t size() const noexcept
+        {
+            return length;
+        }
+    };
+
+    /**
+     * @param r レコード
+     * @return r の命令。命令として正しくなければ std::runtime_error を投げる。
+     */
+    malbolge::Instruction instruction_of(const record &r)
+    {
+        const auto instruction = static_cast<malbolge::Instruction>(r.instruction);
+        if (r.address >= malbolge::word_size || std::ranges::find(malbolge::instructions, instruction) == std::end(malbolge::instructions)) {
+            throw std::runtime_error("corrupt checkpoint record");
+        }
+        return instruction;
+    }
+}
+
+/**
+ * @copydoc search_checkpoint::save(const std::filesystem::path &, const std::size_t, const std::span<const malbolge_machine_state::descriptor>, const std::mt19937 &)
+ */
+void search_checkpoint::save(
+    const std::filesystem::path &path,
+    const std::size_t generation,
+    const std::span<const malbolge_machine_state::descriptor> nodes,
+    const std::mt19937 &engine
+)
+{
+    // 祖先に親より後ろの番号を振る。書き込みの履歴のスナップショットとリンクは、それぞれ同じ祖先の状態を表す。
+    std::unordered_map<const void *, std::uint32_t> indices;
+    std::vector<record> ancestors;
+    std::vector<const write_history::link *> chain;
+    const auto append = [&](const std::uint32_t parent, const write_history::write &w) {
+        const auto [address, data] = w;
+        ancestors.push_back({parent, address, static_cast<std::uint16_t>(*malbolge::decode_operation(address, data))});
+        return static_cast<std::uint32_t>(ancestors.size() - 1);
+    };
+    std::vector<const write_history::snapshot *> snapshots;
+    const auto index_of_snapshot = [&](const write_history::snapshot *snapshot) {
+        // 初期状態は nullptr のスナップショットとして扱う
+        if (!indices.contains(nullptr)) {
+            ancestors.push_back({no_parent, 0, 0});
+            indices.emplace(nullptr, static_cast<std::uint32_t>(ancestors.size() - 1));
+        }
+        // 共有している前のスナップショットは一度だけ書き出す
+        snapshots.clear();
+        for (; !indices.contains(snapshot); snapshot = snapshot->previous.get()) {
+            snapshots.push_back(snapshot);
+        }
+        auto index = indices.at(snapshot);
+        for (auto itr = std::rbegin(snapshots); itr != std::rend(snapshots); ++itr) {
+            for (const auto &w : (*itr)->get_writes()) {
+                index = append(index, w);
+            }
+            indices.emplace(*itr, index);
+        }
+        return index;
+    };
+    const auto index_of = [&](const malbolge_machine_state *const state) {
+        if (!state) {
+            return no_parent;
+        }
+        const auto &history = state->get_history();
+        chain.clear();
+        auto l = history.get_last().get();
+        for (; l && !indices.contains(l); l = l->previous.get()) {
+            chain.push_back(l);
+        }
+        auto index = l ? indices.at(l) : index_of_snapshot(history.get_snapshot().get());
+        for (auto itr = std::rbegin(chain); itr != std::rend(chain); ++itr) {
+            index = append(index, (*itr)->written);
+            indices.emplace(*itr, index);
+        }
+        return index;
+    };
+    std::vector<record> current;
+    current.reserve(nodes.size());
+    for (const auto &node : nodes) {
+        const auto parent = index_of(node.get_parent().get());
+        current.push_back(parent == no_parent
+            ? record{no_parent, 0, 0}
+            : record{parent, node.get_address(), static_cast<std::uint16_t>(node.get_instruction())}
+        );
+    }
+    std::ostringstream engine_state;
+    engine_state << engine;
+    const auto engine_text = engine_state.str();
+    const file_header header = {file_magic, file_version, generation, ancestors.size(), current.size(), engine_text.size()};
+    auto temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream ofs(temporary, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(ancestors.data()), static_cast<std::streamsize>(ancestors.size() * sizeof(record)));
+        ofs.write(reinterpret_cast<const char *>(current.data()), static_cast<std::streamsize>(current.size() * sizeof(record)));
+        ofs.write(engine_text.data(), static_cast<std::streamsize>(engine_text.size()));
+        if (!ofs.flush()) {
+            throw std::runtime_error("cannot write " + temporary.string());
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        throw std::runtime_error("cannot write " + path.string());
+    }
+}
+
+/**
+ * @copydoc search_checkpoint::load(const std::filesystem::path &)
+ */
+search_checkpoint search_checkpoint::load(const std::filesystem::path &path)
+{
+    const mapped_file file(path);
+    if (file.size() < sizeof(file_header)) {
+        throw std::runtime_error("not a checkpoint: " + path.string());
+    }
+    file_header header;
+    std::copy_n(file.data(), sizeof(header), reinterpret_cast<char *>(&header));
+    if (header.magic != file_magic || header.version != file_version) {
+        throw std::runtime_error("not a checkpoint: " + path.string());
+    }
+    const auto record_count = header.ancestor_count + header.node_count;
+    if (
+        record_count > (file.size() - sizeof(header)) / sizeof(record) ||
+        file.size() != sizeof(header) + record_count * sizeof(record) + header.engine_state_size
+    ) {
+        throw std::runtime_error("truncated checkpoint: " + path.string());
+    }
+    const auto records = reinterpret_cast<const record *>(file.data() + sizeof(header));
+    // 祖先を先頭から順に、書き込みと実行をやり直して復元する
+    std::vector<std::shared_ptr<const malbolge_machine_state>> ancestors(header.ancestor_count);
+    for (std::size_t i = 0; i < ancestors.size(); ++i) {
+        const auto &r = records[i];
+        if (r.parent != no_parent && r.parent >= i) {
+            throw std::runtime_error("corrupt checkpoint record");
+        }
+        const auto state = r.parent == no_parent
+            ? malbolge_machine_state::descriptor().materialize()
+            : malbolge_machine_state::descriptor(ancestors[r.parent], r.address, instruction_of(r)).materialize();
+        auto event = state->run(std::numeric_limits<std::size_t>::max(), true);
+        while (event.status == malbolge_machine_state::ExecutionStatus::OutputProduced) {
+            event = state->run(std::numeric_limits<std::size_t>::max(), true);
+        }
+        if (event.status != malbolge_machine_state::ExecutionStatus::MemoryUninitialized) {
+            throw std::runtime_error("checkpoint ancestor does not branch");
+        }
+        ancestors[i] = state;
+    }
+    search_checkpoint checkpoint;
+    checkpoint.generation = header.generation;
+    checkpoint.nodes.reserve(header.node_count);
+    for (std::size_t i = 0; i < header.node_count; ++i) {
+        const auto &r = records[header.ancestor_count + i];
+        if (r.parent == no_parent) {
+            checkpoint.nodes.emplace_back();
+        } else if (r.parent < ancestors.size()) {
+            checkpoint.nodes.emplace_back(ancestors[r.parent], r.address, instruction_of(r));
+        } else {
+            throw std::runtime_error("corrupt checkpoint record");
+        }
+    }
+    std::istringstream engine_state(std::string(file.data() + sizeof(header) + record_count * sizeof(record), header.engine_state_size));
+    if (!(engine_state >> checkpoint.engine)) {
+        throw std::runtime_error("corrupt checkpoint engine state");
+    }
+    return checkpoint;
+}
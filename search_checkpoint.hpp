@@ -0,0 +1,61 @@
+/**
+ * @file search_checkpoint.hpp
+ * @brief ビーム探索のチェックポイント
+ */
+
+#ifndef SEARCH_CHECKPOINT_HPP
+#define SEARCH_CHECKPOINT_HPP
+#include "malbolge_machine_state.hpp"
+#include <vector>
+#include <span>
+#include <random>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief ビーム探索のチェックポイント
+ * @detail 現在の世代の記述子と、それらが参照する祖先の状態を、親の番号と書き込んだ命令だけの固定長のレコードとして保存する。
+ * @detail 祖先は親より後ろに並べるので、読み込むときは先頭から順に、親状態に命令を書き込んで
+ * @detail 未初期化のメモリに行き当たるまで実行し直せば全て復元できる。
+ * @detail レジスタやメモリ、出力は保存しない。祖先を一つ復元するのにかかるのは、その状態が実行した数十ステップ分だけである。
+ * @note ファイルはヘッダ、祖先のレコード、現在の世代のレコード、乱数生成器の状態の順に並び、
+ * @note mmap してそのままレコードの配列として読める。
+ * @note 同じ実行環境（エンディアン）で読み書きすることを前提とする。
+ */
+class search_checkpoint final {
+public:
+    //! 世代カウント
+    std::size_t generation = 1;
+
+    //! 現在の世代
+    std::vector<malbolge_machine_state::descriptor> nodes;
+
+    //! 乱数生成器
+    std::mt19937 engine;
+
+    /**
+     * @brief ファイルに保存する
+     * @param path ファイルのパス
+     * @param generation 世代カウント
+     * @param nodes 現在の世代
+     * @param engine 乱数生成器
+     * @throws std::runtime_error ファイルに書き込めなかった
+     * @note 書きかけのファイルが残らないよう、一時ファイルに書いてから置き換える。
+     */
+    static void save(
+        const std::filesystem::path &path,
+        const std::size_t generation,
+        const std::span<const malbolge_machine_state::descriptor> nodes,
+        const std::mt19937 &engine
+    );
+
+    /**
+     * @brief ファイルから読み込み、祖先の状態を復元する
+     * @param path ファイルのパス
+     * @return 読み込んだチェックポイント
+     * @throws std::runtime_error ファイルを開けないか、形式が正しくない
+     */
+    static search_checkpoint load(const std::filesystem::path &path);
+};
+#endif
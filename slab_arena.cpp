@@ -0,0 +1,150 @@
+/**
+ * @file slab_arena.cpp
+ * @see slab_arena.hpp
+ */
+
+#include "slab_arena.hpp"
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+namespace {
+    /**
+     * @brief スラブの先頭に置くヘッダ
+     */
+    struct slab_header {
+        //! スラブ内で生存しているオブジェクトの数。スラブが確保に使われている間は 1 多い。
+        std::atomic<std::size_t> references = 1;
+    };
+
+    /**
+     * @brief 確保した領域の直前に置くヘッダ
+     */
+    struct allocation_header {
+        //! 領域を確保したスラブ
+        slab_header *slab;
+    };
+
+    //! スラブ内で最初に確保できる位置
+    constexpr std::size_t first_offset = sizeof(slab_header);
+
+    //! 世代カウント
+    std::atomic<std::uint64_t> current_epoch = 0;
+
+    //! 現在確保されているスラブの合計の大きさ
+    std::atomic<std::size_t> reserved = 0;
+
+    //! 以降に作られる slab_allocator がアリーナを使うか否か
+    std::atomic<bool> enabled = true;
+
+    /**
+     * @brief スラブへの参照を一つ手放し、最後の参照であればスラブを解放する
+     * @param slab スラブ
+     */
+    void release(slab_header *const slab) noexcept
+    {
+        if (slab->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            slab->~slab_header();
+            ::operator delete(slab);
+            reserved.fetch_sub(slab_arena::slab_size, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief スレッドごとの確保中のスラブ
+     */
+    struct thread_cache {
+        //! 確保に使っているスラブ
+        slab_header *slab = nullptr;
+
+        //! slab 内で次に確保する位置
+        std::size_t offset = 0;
+
+        //! slab を確保したときの世代カウント
+        std::uint64_t epoch = 0;
+
+        ~thread_cache()
+        {
+            if (slab) {
+                release(slab);
+            }
+        }
+
+        /**
+         * @brief 新しいスラブに切り替える
+         */
+        void refill()
+        {
+            auto *const fresh = new(::operator new(slab_arena::slab_size)) slab_header();
+            reserved.fetch_add(slab_arena::slab_size, std::memory_order_relaxed);
+            if (slab) {
+                release(slab);
+            }
+            slab = fresh;
+            offset = first_offset;
+            epoch = current_epoch.load(std::memory_order_relaxed);
+        }
+    };
+
+    thread_local thread_cache cache;
+}
+
+/**
+ * @copydoc slab_arena::allocate(const std::size_t, const std::size_t)
+ */
+void *slab_arena::allocate(const std::size_t size, const std::size_t alignment)
+{
+    const auto align = [alignment](const std::size_t offset) {
+        return (offset + sizeof(allocation_header) + alignment - 1) / alignment * alignment;
+    };
+    auto offset = align(cache.offset);
+    if (!cache.slab || cache.epoch != current_epoch.load(std::memory_order_relaxed) || offset + size > slab_size) {
+        cache.refill();
+        offset = align(cache.offset);
+    }
+    cache.slab->references.fetch_add(1, std::memory_order_relaxed);
+    cache.offset = offset + size;
+    auto *const p = reinterpret_cast<std::byte *>(cache.slab) + offset;
+    reinterpret_cast<allocation_header *>(p)[-1].slab = cache.slab;
+    return p;
+}
+
+/**
+ * @copydoc slab_arena::deallocate(void *)
+ */
+void slab_arena::deallocate(void *const p) noexcept
+{
+    release(static_cast<allocation_header *>(p)[-1].slab);
+}
+
+/**
+ * @copydoc slab_arena::next_generation()
+ */
+void slab_arena::next_generation() noexcept
+{
+    current_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @copydoc slab_arena::reserved_bytes()
+ */
+std::size_t slab_arena::reserved_bytes() noexcept
+{
+    return reserved.load(std::memory_order_relaxed);
+}
+
+/**
+ * @copydoc slab_arena::set_enabled(const bool)
+ */
+void slab_arena::set_enabled(const bool enabled_) noexcept
+{
+    enabled.store(enabled_, std::memory_order_relaxed);
+}
+
+/**
+ * @copydoc slab_arena::is_enabled()
+ */
+bool slab_arena::is_enabled() noexcept
+{
+    return enabled.load(std::memory_order_relaxed);
+}
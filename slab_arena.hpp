@@ -0,0 +1,141 @@
+/**
+ * @file slab_arena.hpp
+ * @brief 世代ごとのスラブから確保するアリーナアロケータ
+ */
+
+#ifndef SLAB_ARENA_HPP
+#define SLAB_ARENA_HPP
+#include <cstddef>
+#include <memory>
+
+/**
+ * @brief 世代ごとのスラブから確保するアリーナ
+ * @detail 各スレッドは自分専用のスラブからポインタを進めるだけで領域を確保する（bump allocation）。
+ * @detail スラブは生存しているオブジェクトの数を数えており、それがゼロになった時点でまとめて解放される。
+ * @detail 確保した領域の直前には、それを確保したスラブへのポインタを置く。
+ * @detail next_generation() を呼ぶと各スレッドは次の確保から新しいスラブを使うので、
+ * @detail ある世代のノードは同じスラブにまとまり、生き残りに参照されなくなった祖先はスラブごと解放される。
+ */
+class slab_arena final {
+public:
+    //! スラブの大きさ
+    static inline constexpr std::size_t slab_size = 16 * 1024;
+
+    //! スラブから確保できる最大の大きさ。これより大きい要求は ::operator new に回す。
+    static inline constexpr std::size_t max_allocation_size = slab_size / 16;
+
+    slab_arena() = delete;
+
+    /**
+     * @brief スラブから領域を確保する
+     * @param size 確保する大きさ
+     * @param alignment 確保する領域のアラインメント
+     * @return 確保した領域へのポインタ
+     * @throws std::bad_alloc スラブの確保に失敗した
+     * @pre size <= max_allocation_size かつ alignment <= alignof(std::max_align_t)
+     */
+    static void *allocate(const std::size_t size, const std::size_t alignment);
+
+    /**
+     * @brief allocate() で確保した領域を解放する
+     * @param p 解放する領域へのポインタ
+     * @note 確保したスレッドと異なるスレッドから呼んでもよい。
+     */
+    static void deallocate(void *p) noexcept;
+
+    /**
+     * @brief 世代を進める
+     * @note 各スレッドは次の確保から新しいスラブを使う。
+     */
+    static void next_generation() noexcept;
+
+    /**
+     * @return 現在確保されているスラブの合計の大きさ
+     */
+    static std::size_t reserved_bytes() noexcept;
+
+    /**
+     * @brief 以降に作られる slab_allocator がアリーナを使うか否かを設定する
+     * @param enabled アリーナを使うか否か
+     * @note すでに作られた slab_allocator とその確保した領域には影響しない。
+     */
+    static void set_enabled(const bool enabled) noexcept;
+
+    /**
+     * @return 以降に作られる slab_allocator がアリーナを使うか否か
+     */
+    static bool is_enabled() noexcept;
+};
+
+/**
+ * @brief slab_arena から確保するアロケータ
+ * @tparam T 確保する要素の型
+ * @note 作られた時点で slab_arena::is_enabled() が false であれば ::operator new を用いる。
+ */
+template <class T>
+class slab_allocator final {
+    template <class U>
+    friend class slab_allocator;
+
+private:
+    //! slab_arena を使うか否か
+    bool uses_arena;
+
+    /**
+     * @param n 要素数
+     * @return n 個の要素を slab_arena から確保するか否か
+     */
+    inline bool from_arena(const std::size_t n) const noexcept
+    {
+        return uses_arena
+            && n <= slab_arena::max_allocation_size / sizeof(T)
+            && alignof(T) <= alignof(std::max_align_t);
+    }
+
+public:
+    using value_type = T;
+
+    inline slab_allocator() noexcept
+        : uses_arena(slab_arena::is_enabled())
+    {
+    }
+
+    template <class U>
+    inline slab_allocator(const slab_allocator<U> &other) noexcept
+        : uses_arena(other.uses_arena)
+    {
+    }
+
+    /**
+     * @param n 確保する要素数
+     * @return 確保した領域へのポインタ
+     */
+    inline T *allocate(const std::size_t n)
+    {
+        if (from_arena(n)) {
+            return static_cast<T *>(slab_arena::allocate(n * sizeof(T), alignof(T)));
+        } else {
+            return std::allocator<T>().allocate(n);
+        }
+    }
+
+    /**
+     * @param p 解放する領域へのポインタ
+     * @param n 解放する要素数
+     */
+    inline void deallocate(T *const p, const std::size_t n) noexcept
+    {
+        if (from_arena(n)) {
+            slab_arena::deallocate(p);
+        } else {
+            std::allocator<T>().deallocate(p, n);
+        }
+    }
+
+    template <class U>
+    inline bool operator==(const slab_allocator<U> &other) const noexcept
+    {
+        return uses_arena == other.uses_arena;
+    }
+};
+#endif
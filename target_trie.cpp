@@ -0,0 +1,103 @@
+/**
+ * @file target_trie.cpp
+ * @see target_trie.hpp
+ */
+
+#include "target_trie.hpp"
+#include <stdexcept>
+#include <cctype>
+
+/**
+ * @copydoc target_trie::normalize(const char)
+ */
+unsigned char target_trie::normalize(const char c) noexcept
+{
+    return static_cast<unsigned char>(toupper(static_cast<unsigned char>(c)));
+}
+
+/**
+ * @copydoc target_trie::target_trie(std::vector<std::string>)
+ */
+target_trie::target_trie(std::vector<std::string> targets)
+    : nodes(1), target_strings(std::move(targets))
+{
+    if (target_strings.empty()) {
+        throw std::invalid_argument("targets must not be empty.");
+    }
+    for (std::size_t i = 0; i < target_strings.size(); ++i) {
+        if (target_strings[i].empty()) {
+            throw std::invalid_argument("targets must not contain an empty string.");
+        }
+        node_id current = root;
+        for (const auto c : target_strings[i]) {
+            if (const auto child = child_of(current, c)) {
+                current = *child;
+            } else {
+                const auto created = static_cast<node_id>(nodes.size());
+                nodes[current].children.emplace_back(normalize(c), created);
+                nodes.emplace_back();
+                current = created;
+            }
+        }
+        if (nodes[current].target) {
+            throw std::invalid_argument("targets must be distinct ignoring case.");
+        }
+        nodes[current].target = i;
+        update_live_targets(target_strings[i], 1);
+    }
+    retired.assign(target_strings.size(), false);
+}
+
+/**
+ * @copydoc target_trie::retire(const std::size_t)
+ */
+void target_trie::retire(const std::size_t index)
+{
+    if (!retired.at(index)) {
+        retired[index] = true;
+        update_live_targets(target_strings[index], -1);
+    }
+}
+
+/**
+ * @copydoc target_trie::update_live_targets(const std::string_view, const std::ptrdiff_t)
+ */
+void target_trie::update_live_targets(const std::string_view target, const std::ptrdiff_t delta) noexcept
+{
+    node_id current = root;
+    nodes[current].live_targets += delta;
+    for (const auto c : target) {
+        current = *child_of(current, c);
+        nodes[current].live_targets += delta;
+    }
+}
+
+/**
+ * @copydoc target_trie::child_of(const node_id, const char)
+ */
+std::optional<target_trie::node_id> target_trie::child_of(const node_id from, const char c) const noexcept
+{
+    const auto normalized = normalize(c);
+    for (const auto &[label, child] : nodes[from].children) {
+        if (label == normalized) {
+            return child;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @copydoc target_trie::find(const std::string_view, const node_id)
+ */
+std::optional<target_trie::node_id> target_trie::find(const std::string_view s, const node_id from) const noexcept
+{
+    node_id current = from;
+    for (const auto c : s) {
+        if (const auto child = next(current, c)) {
+            current = *child;
+        } else {
+            return std::nullopt;
+        }
+    }
+    return current;
+}
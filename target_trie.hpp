@@ -0,0 +1,157 @@
+/**
+ * @file target_trie.hpp
+ * @brief 目標文字列の集合を表すトライ木
+ */
+
+#ifndef TARGET_TRIE_HPP
+#define TARGET_TRIE_HPP
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 目標文字列の集合を表すトライ木
+ * @detail 出力された文字列がいずれかの目標文字列の接頭辞であるか、いずれかの目標文字列そのものであるかを、
+ * @detail 一文字ずつ辿りながら判定する。共通の接頭辞を持つ目標文字列は同じ節点を共有する。
+ * @note 大文字・小文字の違いは無視する。
+ * @note 解が見つかった目標文字列は retire() で外せる。それにしか続かない接頭辞は、以降どの目標文字列の接頭辞でもないとみなす。
+ */
+class target_trie final {
+public:
+    //! 節点の番号
+    using node_id = std::uint32_t;
+
+    //! 根（空文字列）の節点の番号
+    static inline constexpr node_id root = 0;
+
+private:
+    /**
+     * @brief 節点
+     */
+    struct node {
+        //! 大文字に揃えた文字と、その文字で遷移する子の番号の pair の配列
+        std::vector<std::pair<unsigned char, node_id>> children;
+
+        //! この節点で終わる目標文字列の番号。そのような目標文字列がなければ std::nullopt
+        std::optional<std::size_t> target;
+
+        //! この節点を接頭辞に持つ目標文字列のうち、まだ retire() されていないものの数
+        std::ptrdiff_t live_targets = 0;
+    };
+
+    //! 節点の配列。添字が節点の番号となる。
+    std::vector<node> nodes;
+
+    //! 目標文字列
+    std::vector<std::string> target_strings;
+
+    //! 目標文字列ごとの、retire() されたか否か
+    std::vector<bool> retired;
+
+    /**
+     * @param c 文字
+     * @return 比較に用いる、大文字に揃えた文字
+     */
+    static unsigned char normalize(const char c) noexcept;
+
+    /**
+     * @brief retire() されたか否かによらず一文字分辿る
+     * @param from 辿る前の節点
+     * @param c 次の文字
+     * @return 辿った先の節点。なければ std::nullopt
+     */
+    std::optional<node_id> child_of(const node_id from, const char c) const noexcept;
+
+    /**
+     * @brief 目標文字列の接頭辞に当たる全ての節点の live_targets を増減する
+     * @param target 目標文字列
+     * @param delta 増減する量
+     */
+    void update_live_targets(const std::string_view target, const std::ptrdiff_t delta) noexcept;
+
+public:
+    /**
+     * @param targets 目標文字列の配列
+     * @throws std::invalid_argument targets が空であるか、空文字列を含むか、大文字・小文字の違いを除いて等しい要素を含む
+     */
+    explicit target_trie(std::vector<std::string> targets);
+
+    /**
+     * @brief 一文字分辿る
+     * @param from 辿る前の節点
+     * @param c 次の文字
+     * @return 辿った先の節点。c で始まる続きを持つ、まだ retire() されていない目標文字列がなければ std::nullopt
+     */
+    inline std::optional<node_id> next(const node_id from, const char c) const noexcept
+    {
+        const auto normalized = normalize(c);
+        for (const auto &[label, child] : nodes[from].children) {
+            if (label == normalized) {
+                return nodes[child].live_targets > 0 ? std::optional<node_id>(child) : std::nullopt;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief 次に出力してよい文字を列挙する
+     * @param from 現在の節点
+     * @param f 大文字に揃えた文字を受け取る関数。まだ retire() されていない目標文字列に続く文字についてのみ呼ばれる。
+     */
+    template <class F>
+    void for_each_next(const node_id from, F f) const
+    {
+        for (const auto &[label, child] : nodes[from].children) {
+            if (nodes[child].live_targets > 0) {
+                f(static_cast<char>(label));
+            }
+        }
+    }
+
+    /**
+     * @brief 文字列を辿る
+     * @param s 文字列
+     * @param from 辿り始める節点
+     * @return from から s を辿った先の節点。まだ retire() されていないいずれの目標文字列の接頭辞にもならなければ std::nullopt
+     * @note 区切られた文字列は、前の区切りの結果を from に渡して続きから辿れる。
+     */
+    std::optional<node_id> find(const std::string_view s, const node_id from = root) const noexcept;
+
+    /**
+     * @param n 節点
+     * @return n で終わる目標文字列の番号。そのような目標文字列がないか、retire() されていれば std::nullopt
+     */
+    inline std::optional<std::size_t> target_at(const node_id n) const noexcept
+    {
+        return nodes[n].target && !retired[*nodes[n].target] ? nodes[n].target : std::nullopt;
+    }
+
+    /**
+     * @brief 目標文字列を探索の対象から外す
+     * @param index 目標文字列の番号
+     * @detail 以降、その目標文字列にしか続かない接頭辞は next() と find() で辿れなくなる。
+     * @warning 探索の途中（他のスレッドが next() 等を呼んでいる間）に呼んではならない。
+     */
+    void retire(const std::size_t index);
+
+    /**
+     * @return まだ retire() されていない目標文字列があるか否か
+     */
+    inline bool has_live_targets() const noexcept
+    {
+        return nodes[root].live_targets > 0;
+    }
+
+    /**
+     * @return 目標文字列の配列
+     */
+    inline const std::vector<std::string> &targets() const noexcept
+    {
+        return target_strings;
+    }
+};
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file write_history.cpp
+ * @see write_history.hpp
+ */
+
+#include "write_history.hpp"
+#include "slab_arena.hpp"
+#include <algorithm>
+#include <vector>
+
+/**
+ * @copydoc write_history::push_back(const write &)
+ */
+void write_history::push_back(const write &w)
+{
+    const auto length = static_cast<std::uint32_t>(links() + 1);
+    last = std::allocate_shared<link>(slab_allocator<link>(), link{std::move(last), w, length});
+}
+
+/**
+ * @copydoc write_history::compact()
+ */
+void write_history::compact()
+{
+    if (links() < max_links) {
+        return;
+    }
+    std::vector<write> flattened;
+    flattened.reserve(links());
+    auto append = [&flattened](const write &w) { flattened.push_back(w); };
+    visit_links(last.get(), append);
+    const slab_allocator<snapshot> allocator;
+    for (std::size_t i = 0; i < flattened.size(); i += max_links) {
+        const auto count = std::min(max_links, flattened.size() - i);
+        auto s = std::allocate_shared<snapshot>(allocator);
+        std::copy_n(std::begin(flattened) + i, count, std::begin(s->writes));
+        s->count = static_cast<std::uint32_t>(count);
+        s->length = (base ? base->length : 0) + count;
+        s->previous = std::move(base);
+        base = std::move(s);
+    }
+    last = nullptr;
+}
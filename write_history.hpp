@@ -0,0 +1,169 @@
+/**
+ * @file write_history.hpp
+ * @brief 構造共有する永続的なメモリへの書き込みの履歴
+ */
+
+#ifndef WRITE_HISTORY_HPP
+#define WRITE_HISTORY_HPP
+#include "malbolge.hpp"
+#include <array>
+#include <memory>
+#include <span>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 構造共有する永続的なメモリへの書き込みの履歴
+ * @detail 初期状態から順に、探索で命令を書き込んだアドレスとワードを記録する。
+ * @detail 新しい書き込みは親から共有する不変のリンクの連結リストに繋ぎ、それより前の書き込みはスナップショットに置く。
+ * @detail スナップショットは平坦な配列に数十個分の書き込みを持ち、それより前の書き込みは一つ前のスナップショットへのポインタとして共有する。
+ * @detail 連結リストが max_links 個以上のリンクを持つときに compact() を呼ぶと、連結リストの書き込みだけを新しいスナップショットへ平坦化する。
+ * @detail 平坦化した後に作った子孫はそのスナップショットを共有するので、辿るリンクの数は高々 max_links 個で抑えられ、
+ * @detail 共通の祖先を持つ系列は祖先までのスナップショットを共有するので、メモリ使用量は系列の数と深さの積にはならない。
+ * @note 古いリンクは、それを参照する子孫が全て平坦化するか捨てられた時点で解放される。
+ */
+class write_history final {
+public:
+    //! 書き込んだアドレスとワードの pair
+    using write = std::pair<malbolge::word, malbolge::word>;
+
+    //! compact() で平坦化する連結リストの長さ
+    static inline constexpr std::size_t max_links = 32;
+
+    /**
+     * @brief 平坦化した書き込み
+     * @note slab_arena から確保する。
+     */
+    struct snapshot {
+        //! 一つ前のスナップショット。初期状態の直後のスナップショットでは nullptr
+        std::shared_ptr<const snapshot> previous;
+
+        //! previous より後の書き込み。古い順に先頭の count 個が並ぶ
+        std::array<write, max_links> writes;
+
+        //! previous より後の書き込みの数
+        std::uint32_t count;
+
+        //! 初期状態からこのスナップショットまでの書き込みの数
+        std::size_t length;
+
+        /**
+         * @return previous より後の書き込み
+         */
+        inline std::span<const write> get_writes() const noexcept
+        {
+            return {writes.data(), count};
+        }
+    };
+
+    /**
+     * @brief スナップショットより後の一回分の書き込み
+     */
+    struct link {
+        //! 一つ前のリンク。スナップショットの直後のリンクでは nullptr
+        std::shared_ptr<const link> previous;
+
+        //! 書き込んだアドレスとワード
+        write written;
+
+        //! スナップショットの直後からこのリンクまでのリンクの数
+        std::uint32_t length;
+    };
+
+private:
+    //! 最後のスナップショット。なければ nullptr
+    std::shared_ptr<const snapshot> base;
+
+    //! 最後のリンク。なければ nullptr
+    std::shared_ptr<const link> last;
+
+    /**
+     * @brief スナップショットの書き込みを古い順に辿る
+     * @param s 辿り始めるスナップショット。nullptr ならば何もしない
+     * @param f 各書き込みを受け取る関数
+     */
+    template <class F>
+    static void visit_snapshots(const snapshot *const s, F &f)
+    {
+        if (s) {
+            visit_snapshots(s->previous.get(), f);
+            for (const auto &w : s->get_writes()) {
+                f(w);
+            }
+        }
+    }
+
+    /**
+     * @brief リンクを古い順に辿る
+     * @param l 辿り始めるリンク。nullptr ならば何もしない
+     * @param f 各リンクの書き込みを受け取る関数
+     */
+    template <class F>
+    static void visit_links(const link *const l, F &f)
+    {
+        if (l) {
+            visit_links(l->previous.get(), f);
+            f(l->written);
+        }
+    }
+
+public:
+    /**
+     * @brief 書き込みを一つ追記する
+     * @param w 書き込んだアドレスとワード
+     * @note リンクは slab_arena から確保する。
+     */
+    void push_back(const write &w);
+
+    /**
+     * @brief 連結リストが max_links 個以上のリンクを持つならば、それを今のスナップショットに続くスナップショットへ平坦化する
+     * @note 子孫を作る前に呼べば、子孫は全て平坦化した結果を共有する。
+     * @note スナップショットは slab_arena から確保する。max_links 個を超えるリンクは複数のスナップショットに分ける。
+     */
+    void compact();
+
+    /**
+     * @return スナップショットより後のリンクの数
+     */
+    inline std::size_t links() const noexcept
+    {
+        return last ? last->length : 0;
+    }
+
+    /**
+     * @return 書き込みの数
+     */
+    inline std::size_t size() const noexcept
+    {
+        return (base ? base->length : 0) + links();
+    }
+
+    /**
+     * @return 最後のスナップショット。なければ nullptr
+     */
+    inline const std::shared_ptr<const snapshot> &get_snapshot() const noexcept
+    {
+        return base;
+    }
+
+    /**
+     * @return 最後のリンク。なければ nullptr
+     */
+    inline const std::shared_ptr<const link> &get_last() const noexcept
+    {
+        return last;
+    }
+
+    /**
+     * @brief 書き込みを古い順に辿る
+     * @param f 各書き込みを const write & で受け取る関数
+     */
+    template <class F>
+    void for_each(F f) const
+    {
+        visit_snapshots(base.get(), f);
+        visit_links(last.get(), f);
+    }
+};
+#endif